@@ -0,0 +1,129 @@
+// Compares point lookups on a catalog of unique ISBNs with the index structures, and the keyword
+// index as a BPlusTree of (keyword, id) pairs with the InvertedIndex.
+//
+// Usage: bench_index [N]
+// The benchmark creates its files in the working directory and removes them afterwards.
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BPlusTree.hpp"
+#include "BlockList.hpp"
+#include "HashIndex.hpp"
+#include "InvertedIndex.hpp"
+#include "MappedFile.hpp"
+
+namespace {
+using ISBN = std::array<char, 21>;
+using Keyword = std::array<char, 61>;
+
+double measure(const std::function<void()>& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+void report(const char* index, const char* operation, int n, double ms) {
+    std::printf("%-12s %-16s %10.2f ms %10.1f ns/op\n", index, operation, ms, ms * 1e6 / n);
+}
+ISBN isbn(int i) {
+    ISBN k{};
+    std::snprintf(k.data(), k.size(), "978-%09d", i * 7919 % 1000000007);
+    return k;
+}
+
+// Index must provide insert(key, value) and lookup(index, key) must return the value.
+template <class Index, class Lookup>
+void bench(const char* name, int n, Lookup lookup) {
+    std::filesystem::remove("bench_file");
+    {
+        Index index;
+        index.initialise("bench_file");
+        report(name, "insert", n, measure([&] {
+                   for (int i = 0; i < n; i++) index.insert(isbn(i), i);
+               }));
+        std::mt19937 gen{114514};
+        long long checksum = 0;
+        report(name, "point lookup", n, measure([&] {
+                   for (int i = 0; i < n; i++) checksum += lookup(index, isbn(gen() % n));
+               }));
+        report(name, "missing lookup", n, measure([&] {
+                   for (int i = 0; i < n; i++) checksum += lookup(index, isbn(n + gen() % n));
+               }));
+        if (checksum < 0) std::printf("unreachable\n");
+    }
+    std::filesystem::remove("bench_file");
+}
+
+Keyword keyword(int i) {
+    Keyword k{};
+    std::snprintf(k.data(), k.size(), "keyword-%d", i);
+    return k;
+}
+long long fileSize(const std::string& file_name) {
+    return std::filesystem::exists(file_name) ? std::filesystem::file_size(file_name) : 0;
+}
+// Every book has 3 keywords, where keyword i is about twice as common as keyword 2i. The queries
+// ask for the books with two keywords.
+template <class Index, class Query>
+void benchKeywords(const char* name, int n, Query query) {
+    std::filesystem::remove("bench_file");
+    std::filesystem::remove("bench_file_postings");
+    {
+        Index index;
+        index.initialise("bench_file");
+        std::mt19937 gen{1919810};
+        std::uniform_real_distribution<double> dist(0, 1);
+        auto pick = [&] { return static_cast<int>(1 / (dist(gen) * 0.999 + 0.001)) - 1; };
+        report(name, "keyword insert", n * 3, measure([&] {
+                   for (int i = 1; i <= n; i++) {
+                       for (int j = 0; j < 3; j++) index.insert(keyword(pick()), i);
+                   }
+               }));
+        const int queries = 1000;
+        long long checksum = 0;
+        report(name, "keyword AND", queries, measure([&] {
+                   for (int i = 0; i < queries; i++) {
+                       checksum += query(index, keyword(gen() % 20), keyword(gen() % 20));
+                   }
+               }));
+        if (checksum < 0) std::printf("unreachable\n");
+    }
+    std::printf("%-12s %-16s %10.1f KB\n", name, "file size",
+                (fileSize("bench_file") + fileSize("bench_file_postings")) / 1024.0);
+    std::filesystem::remove("bench_file");
+    std::filesystem::remove("bench_file_postings");
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int n = argc > 1 ? std::stoi(argv[1]) : 100000;
+    auto first_value = [](auto& index, const ISBN& key) {
+        int result = 0;
+        index.query(key, [&result](int value) { result = value; });
+        return result;
+    };
+    bench<BlockList<ISBN, int, MappedFile>>("BlockList", n, first_value);
+    bench<BPlusTree<ISBN, int, MappedFile>>("BPlusTree", n, first_value);
+    bench<HashIndex<ISBN, int, MappedFile>>(
+        "HashIndex", n, [](auto& index, const ISBN& key) { return index.find(key).value_or(0); });
+    benchKeywords<BPlusTree<Keyword, int, MappedFile>>(
+        "BPlusTree", n, [](auto& index, const Keyword& a, const Keyword& b) {
+            std::vector<int> result;
+            std::ranges::set_intersection(index.query(a), index.query(b),
+                                          std::back_inserter(result));
+            return result.size();
+        });
+    benchKeywords<InvertedIndex<Keyword, MappedFile>>(
+        "Inverted", n, [](auto& index, const Keyword& a, const Keyword& b) {
+            return index.query({a, b}, {}).size();
+        });
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Compares the storage backends of MemoryRiver and BlockList.
+//
+// Usage: bench_storage [N]
+// The benchmark creates its files in the working directory and removes them afterwards.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BlockList.hpp"
+#include "MemoryRiver.hpp"
+
+namespace {
+struct Record {
+    int header[4];
+    char payload[240];
+};
+
+double measure(const std::function<void()>& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+void report(const char* backend, const char* operation, int n, double ms) {
+    std::printf("%-26s %-24s %10.2f ms %10.1f ns/op\n", backend, operation, ms, ms * 1e6 / n);
+}
+
+template <class Storage>
+void benchMemoryRiver(const char* backend, int n, size_t cache_size = 0) {
+    std::filesystem::remove("bench_file");
+    std::mt19937 gen{114514};
+    {
+        MemoryRiver<Record, 1, Storage> mr("bench_file");
+        mr.initialise();
+        mr.setCacheCapacity(cache_size);
+        Record record{};
+        std::vector<int> ids(n);
+        report(backend, "write", n, measure([&] {
+                   for (int i = 0; i < n; i++) ids[i] = mr.write(record);
+               }));
+        report(backend, "random read", n, measure([&] {
+                   for (int i = 0; i < n; i++) mr.read(record, ids[gen() % n]);
+               }));
+        report(backend, "random partial read", n, measure([&] {
+                   int header;
+                   for (int i = 0; i < n; i++) mr.read(header, ids[gen() % n], 0);
+               }));
+        report(backend, "random partial update", n, measure([&] {
+                   for (int i = 0; i < n; i++) mr.update(i, ids[gen() % n], 0);
+               }));
+    }
+    std::filesystem::remove("bench_file");
+}
+
+template <class Storage>
+void benchBlockList(const char* backend, int n, size_t cache_size = 0) {
+    std::filesystem::remove("bench_file");
+    std::mt19937 gen{114514};
+    {
+        BlockList<std::array<char, 21>, int, Storage> list;
+        list.initialise("bench_file");
+        list.setCacheCapacity(cache_size);
+        auto key = [](int i) {
+            std::array<char, 21> k{};
+            std::snprintf(k.data(), k.size(), "ISBN-%08d", i * 7919 % 1000003);
+            return k;
+        };
+        report(backend, "BlockList insert", n, measure([&] {
+                   for (int i = 0; i < n; i++) list.insert(key(i), i);
+               }));
+        report(backend, "BlockList query", n, measure([&] {
+                   for (int i = 0; i < n; i++) list.query(key(gen() % n));
+               }));
+    }
+    std::filesystem::remove("bench_file");
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int n = argc > 1 ? std::stoi(argv[1]) : 100000;
+    benchMemoryRiver<PagedFile>("pread/pwrite", n);
+    benchMemoryRiver<PagedFile>("pread/pwrite + 4MiB cache", n, 4 << 20);
+    benchMemoryRiver<MappedFile>("mmap", n);
+    const int m = n / 10;
+    benchBlockList<PagedFile>("pread/pwrite", m);
+    benchBlockList<PagedFile>("pread/pwrite + 4MiB cache", m, 4 << 20);
+    benchBlockList<MappedFile>("mmap", m);
+    return 0;
+}
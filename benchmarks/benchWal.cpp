@@ -0,0 +1,99 @@
+// Compares durable small writes synced one by one with the group commit of the WriteAheadLog, as
+// concurrent requests to the server would make them.
+//
+// Usage: bench_wal [N]
+// The benchmark creates its files in the working directory and removes them afterwards.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PagedFile.hpp"
+#include "WriteAheadLog.hpp"
+
+namespace {
+struct Record {
+    int header[4];
+    char payload[240];
+};
+
+double measure(const std::function<void()>& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+void report(const char* mode, int threads, int n, double ms) {
+    std::printf("%-22s %2d threads %10.2f ms %10.1f us/op\n", mode, threads, ms, ms * 1e3 / n);
+}
+
+// Runs n transactions on threads threads, each of which writes two records.
+void runTransactions(int threads, int n, const std::function<void(int)>& transaction) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (int i = t; i < n; i += threads) transaction(i);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+void benchSyncEach(int threads, int n) {
+    std::filesystem::remove("bench_file");
+    {
+        PagedFile file;
+        file.open("bench_file");
+        const Record record{};
+        report("fsync per write", threads, n, measure([&] {
+                   runTransactions(threads, n, [&](int i) {
+                       file.write(reinterpret_cast<const char*>(&record), 2LL * i * sizeof(Record),
+                                  sizeof(Record));
+                       file.sync();
+                       file.write(reinterpret_cast<const char*>(&record),
+                                  (2LL * i + 1) * sizeof(Record), sizeof(Record));
+                       file.sync();
+                   });
+               }));
+    }
+    std::filesystem::remove("bench_file");
+}
+
+void benchGroupCommit(int threads, int n) {
+    std::filesystem::remove("bench_file");
+    std::filesystem::remove("bench_wal");
+    auto& log = WriteAheadLog::getInstance();
+    log.open("bench_wal");
+    {
+        PagedFile file;
+        file.open("bench_file");
+        const Record record{};
+        const size_t commits = log.getCommitCount();
+        report("WAL group commit", threads, n, measure([&] {
+                   runTransactions(threads, n, [&](int i) {
+                       WriteAheadLog::Transaction transaction;
+                       file.write(reinterpret_cast<const char*>(&record), 2LL * i * sizeof(Record),
+                                  sizeof(Record));
+                       file.write(reinterpret_cast<const char*>(&record),
+                                  (2LL * i + 1) * sizeof(Record), sizeof(Record));
+                   });
+               }));
+        std::printf("%-22s %2d threads %10.1f transactions per sync\n", "", threads,
+                    static_cast<double>(n) / (log.getCommitCount() - commits));
+    }
+    log.close();
+    std::filesystem::remove("bench_file");
+    std::filesystem::remove("bench_wal");
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int n = argc > 1 ? std::stoi(argv[1]) : 2000;
+    for (const int threads : {1, 4, 16}) {
+        benchSyncEach(threads, n);
+        benchGroupCommit(threads, n);
+    }
+    return 0;
+}
@@ -0,0 +1,566 @@
+#ifndef BOOKSTORE_BPLUSTREE_HPP
+#define BOOKSTORE_BPLUSTREE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "MemoryRiver.hpp"
+
+// A persistent container that can store ordered key-value pairs like std::multimap and provides
+// logarithmic time complexity for operations. It has the same interface as BlockList.
+//
+// Every node occupies exactly one page, and the header of the file is padded to a page, so that a
+// node never straddles two pages. A leaf uses the space of the children of an internal node for
+// more keys. The leaves are linked to their right siblings for scans.
+//
+// Template Args:
+//   Key: The type of the key. Must be comparable using operator< and be POD.
+//   T: The type of the value. Must be comparable using operator< and be POD.
+//   Storage: The file backend of the underlying MemoryRiver. Default set to PagedFile.
+template <class Key, class T, class Storage = PagedFile>
+class BPlusTree {
+    // The aggregate struct representing a key-value pair.
+    struct KeyValuePair {
+        Key first;
+        T second;
+        auto operator<=>(const KeyValuePair&) const = default;
+    };
+
+public:
+    // A forward iterator over the pairs in ascending order, which holds one leaf at a time.
+    // It is invalidated by any modification of the BPlusTree.
+    class Iterator {
+    public:
+        using value_type = std::pair<Key, T>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        Iterator() = default;
+        value_type operator*() const { return {keys[i].first, keys[i].second}; }
+        Iterator& operator++() {
+            ++i;
+            skipFinishedLeaves();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const Iterator& other) const { return id == other.id && i == other.i; }
+
+    private:
+        friend class BPlusTree;
+        BPlusTree* tree = nullptr;
+        int id = 0;    // the index of the current leaf, or 0 at the end
+        int i = 0;     // the position in the current leaf
+        int next = 0;  // the index of the right sibling of the current leaf
+        std::vector<KeyValuePair> keys;
+
+        // Points to the element i of the leaf id, or the end if id is 0.
+        Iterator(BPlusTree* _tree, int _id, int _i) : tree(_tree), id(_id), i(_i) {
+            if (id) load();
+            skipFinishedLeaves();
+        }
+        void load() {
+            const Node leaf = tree->getNode(id);
+            keys.assign(leaf.keys(), leaf.keys() + leaf.count);
+            next = leaf.next;
+        }
+        // Moves to the next non-empty leaf if the current one has been finished.
+        void skipFinishedLeaves() {
+            while (id && i == keys.size()) {
+                id = next;
+                i = 0;
+                keys.clear();
+                if (id) load();
+            }
+        }
+    };
+
+    // Initializes BPlusTree with file_name. Will create a new file if the file doesn't exist.
+    void initialise(const std::string& file_name);
+    // Inserts (key, value). Do nothing if (key, value) already exists.
+    void insert(const Key& key, const T& value);
+    // Erases (key, value). Do nothing if (key, value) doesn't exist.
+    void erase(const Key& key, const T& value);
+    // Returns all values with the given key. Returns empty vectors if no such value exists.
+    std::vector<T> query(const Key& key);
+    // Calls func(value) for all values with the given key in ascending order.
+    template <class Func>
+    void query(const Key& key, Func&& func);
+    // Returns the number of values with the given key, counting no more than limit.
+    size_t count(const Key& key, size_t limit);
+    // Returns all values in this.
+    std::vector<T> queryAll();
+    std::vector<std::pair<Key, T>> queryAllKeyValuePairs();
+    // Returns the iterator to the first pair, or to the first pair whose key is not less than key.
+    Iterator begin() { return Iterator(this, firstLeaf(), 0); }
+    Iterator begin(const Key& key);
+    Iterator end() { return Iterator(this, 0, 0); }
+    // Returns the pairs whose keys are in [lo, hi], reading the leaves as they are iterated.
+    std::ranges::subrange<Iterator> range(const Key& lo, const Key& hi);
+    // Builds the tree from pairs sorted in ascending order, packing the nodes densely.
+    // Prerequisite: the tree must be empty.
+    void bulkLoad(const std::vector<std::pair<Key, T>>& pairs);
+
+    // Sets the memory budget of the page cache of the underlying file. Zero disables the cache.
+    void setCacheCapacity(size_t bytes) { file.setCacheCapacity(bytes); }
+    size_t getCacheHits() const { return file.getCacheHits(); }
+    size_t getCacheMisses() const { return file.getCacheMisses(); }
+    // Returns true if file_name holds a BPlusTree rather than a file of another format, such as the
+    // BlockList of older versions.
+    static bool isTreeFile(const std::string& file_name);
+
+private:
+    // The fanout is chosen so that a node fills a page.
+    static constexpr int NODE_SIZE = PagedFile::PAGE_SIZE;
+    // The size of is_leaf, count and next, padded to the alignment of the keys and children.
+    static constexpr int ALIGNMENT = std::max(alignof(KeyValuePair), alignof(int));
+    static constexpr int HEADER_SIZE = (3 * sizeof(int) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    static constexpr int BODY_SIZE = NODE_SIZE - HEADER_SIZE;
+    // The maximum and minimum number of keys in an internal node other than the root.
+    static constexpr int MAX_KEYS = std::max<int>(
+        4, (BODY_SIZE - sizeof(int)) / (sizeof(KeyValuePair) + sizeof(int)) - 1);
+    static constexpr int MIN_KEYS = MAX_KEYS / 2;
+    // The maximum and minimum number of keys in a leaf other than the root.
+    static constexpr int MAX_LEAF_KEYS = std::max<int>(4, BODY_SIZE / sizeof(KeyValuePair) - 1);
+    static constexpr int MIN_LEAF_KEYS = MAX_LEAF_KEYS / 2;
+    // The number of keys in a node built by bulkLoad, leaving room for later insertions.
+    static constexpr int BULK_LOAD_KEYS = std::max(MIN_KEYS, MAX_KEYS * 3 / 4);
+    static constexpr int BULK_LOAD_LEAF_KEYS = std::max(MIN_LEAF_KEYS, MAX_LEAF_KEYS * 3 / 4);
+    // The infos of the file, after the two ints of the MemoryRiver itself, fill the first page.
+    static constexpr int INFO_LEN = NODE_SIZE / sizeof(int) - 2;
+    // The info that marks the file as a BPlusTree, and its value ("TREE").
+    static constexpr int MAGIC_INFO = 2;
+    static constexpr int MAGIC = 0x45455254;
+
+    // The keys and children of an internal node. Elements in children[i] are less than keys[i],
+    // and elements in children[i + 1] are not less than keys[i].
+    struct InternalBody {
+        KeyValuePair keys[MAX_KEYS + 1];  // one additional space for splitting
+        int children[MAX_KEYS + 2];
+    };
+    // The data structure of a node. In a leaf, keys are the elements stored in ascending order.
+    struct Node {
+        int is_leaf;
+        int count;  // the number of keys
+        int next;   // the index of the right sibling of a leaf
+        union {
+            KeyValuePair leaf_keys[MAX_LEAF_KEYS + 1];  // one additional space for splitting
+            InternalBody internal;
+            char body[BODY_SIZE];
+        };
+
+        KeyValuePair* keys() { return is_leaf ? leaf_keys : internal.keys; }
+        const KeyValuePair* keys() const { return is_leaf ? leaf_keys : internal.keys; }
+        int* children() { return internal.children; }
+        const int* children() const { return internal.children; }
+    };
+    static_assert(sizeof(Node) == NODE_SIZE, "a node must fill a page");
+
+    static int maxKeys(const Node& node) { return node.is_leaf ? MAX_LEAF_KEYS : MAX_KEYS; }
+    static int minKeys(const Node& node) { return node.is_leaf ? MIN_LEAF_KEYS : MIN_KEYS; }
+
+    // The MemoryRiver that store all nodes.
+    // The first info stores the index of the root, or 0 if the tree is empty, and the second one
+    // stores MAGIC. The others pad the header of the file to a page.
+    MemoryRiver<Node, INFO_LEN, Storage> file;
+    int root = 0;
+
+    void setRoot(int id) {
+        root = id;
+        file.writeInfo(id, 1);
+    }
+    Node getNode(int id) {
+        Node node;
+        file.read(node, id);
+        return node;
+    }
+    void setNode(int id, const Node& node) { file.update(node, id); }
+    // Returns the leftmost leaf that may contain elements with the given key.
+    int findLeaf(const Key& key);
+    // Returns the iterator to the first element e with before(e) false. before must be true for a
+    // prefix of the elements.
+    template <class Before>
+    Iterator seek(Before before);
+    // Returns the leftmost leaf.
+    int firstLeaf();
+    // Restores the balance of the tree after node has lost a key.
+    // path is the list of (node id, child position) from the root to the parent of node.
+    void rebalance(int id, Node& node, std::vector<std::pair<int, int>>& path);
+};
+
+template <class Key, class T, class Storage>
+void BPlusTree<Key, T, Storage>::initialise(const std::string& file_name) {
+    file.initialise(file_name);
+    file.getInfo(root, 1);
+    int magic;
+    file.getInfo(magic, MAGIC_INFO);
+    // only a new file is marked, so that a file of an older format is still found by migrate_index
+    if (magic != MAGIC && !file.getCount()) file.writeInfo(MAGIC, MAGIC_INFO);
+}
+template <class Key, class T, class Storage>
+bool BPlusTree<Key, T, Storage>::isTreeFile(const std::string& file_name) {
+    return MemoryRiver<Node, INFO_LEN, Storage>::peekInfo(file_name, MAGIC_INFO) == MAGIC;
+}
+template <class Key, class T, class Storage>
+void BPlusTree<Key, T, Storage>::insert(const Key& key, const T& value) {
+    const auto elem = KeyValuePair{key, value};
+    if (!root) {
+        Node leaf{};
+        leaf.is_leaf = 1;
+        leaf.count = 1;
+        leaf.keys()[0] = elem;
+        setRoot(file.write(leaf));
+        return;
+    }
+    std::vector<std::pair<int, int>> path;
+    int id = root;
+    Node node = getNode(id);
+    while (!node.is_leaf) {
+        int pos = std::upper_bound(node.keys(), node.keys() + node.count, elem) - node.keys();
+        path.emplace_back(id, pos);
+        id = node.children()[pos];
+        node = getNode(id);
+    }
+    int pos = std::lower_bound(node.keys(), node.keys() + node.count, elem) - node.keys();
+    if (pos < node.count && node.keys()[pos] == elem) return;
+    std::copy_backward(node.keys() + pos, node.keys() + node.count, node.keys() + node.count + 1);
+    node.keys()[pos] = elem;
+    ++node.count;
+
+    // split the overflowed nodes from bottom to top
+    while (node.count > maxKeys(node)) {
+        Node right{};
+        right.is_leaf = node.is_leaf;
+        const int mid = node.count / 2;
+        KeyValuePair separator;
+        if (node.is_leaf) {
+            right.count = node.count - mid;
+            std::copy(node.keys() + mid, node.keys() + node.count, right.keys());
+            right.next = node.next;
+            separator = right.keys()[0];
+        } else {
+            // keys[mid] is moved up into the parent
+            right.count = node.count - mid - 1;
+            std::copy(node.keys() + mid + 1, node.keys() + node.count, right.keys());
+            std::copy(node.children() + mid + 1, node.children() + node.count + 1,
+                      right.children());
+            separator = node.keys()[mid];
+        }
+        node.count = mid;
+        const int right_id = file.write(right);
+        if (node.is_leaf) node.next = right_id;
+        setNode(id, node);
+
+        if (path.empty()) {  // the root is split
+            Node new_root{};
+            new_root.count = 1;
+            new_root.keys()[0] = separator;
+            new_root.children()[0] = id;
+            new_root.children()[1] = right_id;
+            setRoot(file.write(new_root));
+            return;
+        }
+        int child_pos;
+        std::tie(id, child_pos) = path.back();
+        path.pop_back();
+        node = getNode(id);
+        std::copy_backward(node.keys() + child_pos, node.keys() + node.count,
+                           node.keys() + node.count + 1);
+        std::copy_backward(node.children() + child_pos + 1, node.children() + node.count + 1,
+                           node.children() + node.count + 2);
+        node.keys()[child_pos] = separator;
+        node.children()[child_pos + 1] = right_id;
+        ++node.count;
+    }
+    setNode(id, node);
+}
+template <class Key, class T, class Storage>
+void BPlusTree<Key, T, Storage>::erase(const Key& key, const T& value) {
+    if (!root) return;  // the tree is empty
+    const auto elem = KeyValuePair{key, value};
+    std::vector<std::pair<int, int>> path;
+    int id = root;
+    Node node = getNode(id);
+    while (!node.is_leaf) {
+        int pos = std::upper_bound(node.keys(), node.keys() + node.count, elem) - node.keys();
+        path.emplace_back(id, pos);
+        id = node.children()[pos];
+        node = getNode(id);
+    }
+    int pos = std::lower_bound(node.keys(), node.keys() + node.count, elem) - node.keys();
+    if (pos == node.count || node.keys()[pos] != elem) return;
+    std::copy(node.keys() + pos + 1, node.keys() + node.count, node.keys() + pos);
+    --node.count;
+    rebalance(id, node, path);
+}
+template <class Key, class T, class Storage>
+std::vector<T> BPlusTree<Key, T, Storage>::query(const Key& key) {
+    std::vector<T> results;
+    query(key, [&results](const T& value) { results.push_back(value); });
+    return results;
+}
+template <class Key, class T, class Storage>
+template <class Func>
+void BPlusTree<Key, T, Storage>::query(const Key& key, Func&& func) {
+    for (int id = findLeaf(key); id;) {
+        const Node leaf = getNode(id);
+        auto it = std::partition_point(leaf.keys(), leaf.keys() + leaf.count,
+                                       [&key](const KeyValuePair& e) { return e.first < key; });
+        for (; it != leaf.keys() + leaf.count; ++it) {
+            if (key < it->first) return;
+            func(it->second);
+        }
+        id = leaf.next;
+    }
+}
+template <class Key, class T, class Storage>
+size_t BPlusTree<Key, T, Storage>::count(const Key& key, size_t limit) {
+    size_t result = 0;
+    for (auto it = begin(key), last = end(); result < limit && it != last; ++it) {
+        if (key < (*it).first) break;
+        ++result;
+    }
+    return result;
+}
+template <class Key, class T, class Storage>
+std::vector<T> BPlusTree<Key, T, Storage>::queryAll() {
+    std::vector<T> results;
+    for (int id = firstLeaf(); id;) {
+        const Node leaf = getNode(id);
+        for (int i = 0; i < leaf.count; i++) {
+            results.push_back(leaf.keys()[i].second);
+        }
+        id = leaf.next;
+    }
+    return results;
+}
+template <class Key, class T, class Storage>
+std::vector<std::pair<Key, T>> BPlusTree<Key, T, Storage>::queryAllKeyValuePairs() {
+    std::vector<std::pair<Key, T>> results;
+    for (int id = firstLeaf(); id;) {
+        const Node leaf = getNode(id);
+        for (int i = 0; i < leaf.count; i++) {
+            results.emplace_back(leaf.keys()[i].first, leaf.keys()[i].second);
+        }
+        id = leaf.next;
+    }
+    return results;
+}
+template <class Key, class T, class Storage>
+typename BPlusTree<Key, T, Storage>::Iterator BPlusTree<Key, T, Storage>::begin(const Key& key) {
+    return seek([&key](const KeyValuePair& e) { return e.first < key; });
+}
+template <class Key, class T, class Storage>
+std::ranges::subrange<typename BPlusTree<Key, T, Storage>::Iterator>
+BPlusTree<Key, T, Storage>::range(const Key& lo, const Key& hi) {
+    if (hi < lo) return {end(), end()};
+    return {begin(lo), seek([&hi](const KeyValuePair& e) { return !(hi < e.first); })};
+}
+template <class Key, class T, class Storage>
+void BPlusTree<Key, T, Storage>::bulkLoad(const std::vector<std::pair<Key, T>>& pairs) {
+    assert(!root);
+    if (pairs.empty()) return;
+    // (index, smallest element) of the nodes in the level being built
+    std::vector<std::pair<int, KeyValuePair>> level;
+
+    // Splits n items into the fewest groups of at most capacity items, with balanced sizes.
+    auto split = [](int n, int capacity) {
+        const int groups = (n + capacity - 1) / capacity;
+        std::vector<int> sizes(groups, n / groups);
+        for (int i = 0; i < n % groups; i++) ++sizes[i];
+        return sizes;
+    };
+
+    int begin = 0;
+    for (int size : split(pairs.size(), BULK_LOAD_LEAF_KEYS)) {
+        Node leaf{};
+        leaf.is_leaf = 1;
+        leaf.count = size;
+        for (int i = 0; i < size; i++) {
+            leaf.keys()[i] = KeyValuePair{pairs[begin + i].first, pairs[begin + i].second};
+        }
+        begin += size;
+        const int id = file.write(leaf);
+        if (!level.empty()) file.update(id, level.back().first, offsetof(Node, next));
+        level.emplace_back(id, leaf.keys()[0]);
+    }
+    while (level.size() > 1) {
+        std::vector<std::pair<int, KeyValuePair>> upper;
+        begin = 0;
+        for (int size : split(level.size(), BULK_LOAD_KEYS + 1)) {
+            Node node{};
+            node.count = size - 1;
+            for (int i = 0; i < size; i++) {
+                node.children()[i] = level[begin + i].first;
+                if (i) node.keys()[i - 1] = level[begin + i].second;
+            }
+            upper.emplace_back(file.write(node), level[begin].second);
+            begin += size;
+        }
+        level = std::move(upper);
+    }
+    setRoot(level.front().first);
+}
+template <class Key, class T, class Storage>
+int BPlusTree<Key, T, Storage>::findLeaf(const Key& key) {
+    int id = root;
+    while (id) {
+        const Node node = getNode(id);
+        if (node.is_leaf) break;
+        // children[i] can't contain key if keys[i].first < key
+        auto it = std::partition_point(node.keys(), node.keys() + node.count,
+                                       [&key](const KeyValuePair& e) { return e.first < key; });
+        id = node.children()[it - node.keys()];
+    }
+    return id;
+}
+template <class Key, class T, class Storage>
+template <class Before>
+typename BPlusTree<Key, T, Storage>::Iterator BPlusTree<Key, T, Storage>::seek(Before before) {
+    int id = root;
+    while (id) {
+        const Node node = getNode(id);
+        if (node.is_leaf) break;
+        // the elements in children[i] are less than keys[i], so they are all before the target
+        // if before(keys[i]) holds
+        id = node.children()[std::partition_point(node.keys(), node.keys() + node.count, before) -
+                           node.keys()];
+    }
+    Iterator result(this, id, 0);
+    if (result.id == id) {
+        result.i = std::partition_point(result.keys.begin(), result.keys.end(), before) -
+                   result.keys.begin();
+        result.skipFinishedLeaves();
+    }
+    return result;
+}
+template <class Key, class T, class Storage>
+int BPlusTree<Key, T, Storage>::firstLeaf() {
+    int id = root;
+    while (id) {
+        const Node node = getNode(id);
+        if (node.is_leaf) break;
+        id = node.children()[0];
+    }
+    return id;
+}
+template <class Key, class T, class Storage>
+void BPlusTree<Key, T, Storage>::rebalance(int id, Node& node,
+                                           std::vector<std::pair<int, int>>& path) {
+    while (true) {
+        if (path.empty()) {  // node is the root
+            if (node.count == 0) {
+                // the tree is empty, or the only child becomes the new root
+                setRoot(node.is_leaf ? 0 : node.children()[0]);
+                file.erase(id);
+            } else {
+                setNode(id, node);
+            }
+            return;
+        }
+        if (node.count >= minKeys(node)) {
+            setNode(id, node);
+            return;
+        }
+        auto [parent_id, pos] = path.back();
+        path.pop_back();
+        Node parent = getNode(parent_id);
+
+        if (pos > 0) {
+            const int left_id = parent.children()[pos - 1];
+            Node left = getNode(left_id);
+            if (left.count > minKeys(left)) {  // borrow the last key of the left sibling
+                std::copy_backward(node.keys(), node.keys() + node.count,
+                                   node.keys() + node.count + 1);
+                if (node.is_leaf) {
+                    node.keys()[0] = left.keys()[left.count - 1];
+                    parent.keys()[pos - 1] = node.keys()[0];
+                } else {
+                    std::copy_backward(node.children(), node.children() + node.count + 1,
+                                       node.children() + node.count + 2);
+                    node.keys()[0] = parent.keys()[pos - 1];
+                    node.children()[0] = left.children()[left.count];
+                    parent.keys()[pos - 1] = left.keys()[left.count - 1];
+                }
+                --left.count;
+                ++node.count;
+                setNode(left_id, left);
+                setNode(id, node);
+                setNode(parent_id, parent);
+                return;
+            }
+            // merge node into the left sibling
+            if (node.is_leaf) {
+                std::copy(node.keys(), node.keys() + node.count, left.keys() + left.count);
+                left.count += node.count;
+                left.next = node.next;
+            } else {
+                left.keys()[left.count] = parent.keys()[pos - 1];
+                std::copy(node.keys(), node.keys() + node.count, left.keys() + left.count + 1);
+                std::copy(node.children(), node.children() + node.count + 1,
+                          left.children() + left.count + 1);
+                left.count += node.count + 1;
+            }
+            setNode(left_id, left);
+            file.erase(id);
+            std::copy(parent.keys() + pos, parent.keys() + parent.count, parent.keys() + pos - 1);
+            std::copy(parent.children() + pos + 1, parent.children() + parent.count + 1,
+                      parent.children() + pos);
+        } else {
+            const int right_id = parent.children()[pos + 1];
+            Node right = getNode(right_id);
+            if (right.count > minKeys(right)) {  // borrow the first key of the right sibling
+                if (node.is_leaf) {
+                    node.keys()[node.count] = right.keys()[0];
+                    std::copy(right.keys() + 1, right.keys() + right.count, right.keys());
+                    parent.keys()[pos] = right.keys()[0];
+                } else {
+                    node.keys()[node.count] = parent.keys()[pos];
+                    node.children()[node.count + 1] = right.children()[0];
+                    parent.keys()[pos] = right.keys()[0];
+                    std::copy(right.keys() + 1, right.keys() + right.count, right.keys());
+                    std::copy(right.children() + 1, right.children() + right.count + 1,
+                              right.children());
+                }
+                --right.count;
+                ++node.count;
+                setNode(right_id, right);
+                setNode(id, node);
+                setNode(parent_id, parent);
+                return;
+            }
+            // merge the right sibling into node
+            if (node.is_leaf) {
+                std::copy(right.keys(), right.keys() + right.count, node.keys() + node.count);
+                node.count += right.count;
+                node.next = right.next;
+            } else {
+                node.keys()[node.count] = parent.keys()[pos];
+                std::copy(right.keys(), right.keys() + right.count, node.keys() + node.count + 1);
+                std::copy(right.children(), right.children() + right.count + 1,
+                          node.children() + node.count + 1);
+                node.count += right.count + 1;
+            }
+            setNode(id, node);
+            file.erase(right_id);
+            std::copy(parent.keys() + pos + 1, parent.keys() + parent.count, parent.keys() + pos);
+            std::copy(parent.children() + pos + 2, parent.children() + parent.count + 1,
+                      parent.children() + pos + 1);
+        }
+        --parent.count;
+        id = parent_id;
+        node = parent;
+    }
+}
+
+#endif  // BOOKSTORE_BPLUSTREE_HPP
@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <iterator>
+#include <ranges>
 #include <string>
 #include <utility>
 #include <vector>
@@ -12,12 +14,70 @@
 // A persistent container that can store ordered key-value pairs like std::multimap and provides
 // square root time complexity for operations.
 //
+// The header of every block is mirrored in an in-memory directory, so locating a block is a binary
+// search without I/O, and only the blocks that are actually modified or scanned are read. Only the
+// live elements of a block are read, and only the changed part of it is written back.
+//
 // Template Args:
 //   Key: The type of the key. Must be comparable using operator< and be POD.
 //   T: The type of the value. Must be comparable using operator< and be POD.
-template <class Key, class T>
+//   Storage: The file backend of the underlying MemoryRiver. Default set to PagedFile.
+template <class Key, class T, class Storage = PagedFile>
 class BlockList {
+    // The aggregate struct representing a key-value pair.
+    struct KeyValuePair {
+        Key first;
+        T second;
+        auto operator<=>(const KeyValuePair&) const = default;
+    };
+
 public:
+    // A forward iterator over the pairs in ascending order, which holds one block at a time.
+    // It is invalidated by any modification of the BlockList.
+    class Iterator {
+    public:
+        using value_type = std::pair<Key, T>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        Iterator() = default;
+        value_type operator*() const { return {data[i].first, data[i].second}; }
+        Iterator& operator++() {
+            ++i;
+            skipFinishedBlocks();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const Iterator& other) const { return pos == other.pos && i == other.i; }
+
+    private:
+        friend class BlockList;
+        BlockList* list = nullptr;
+        int pos = 0;  // the position of the current block in directory
+        int i = 0;    // the position in the current block
+        std::vector<KeyValuePair> data;
+
+        // Points to the element i of the block directory[pos], or the end if pos is past the end.
+        Iterator(BlockList* _list, int _pos, int _i) : list(_list), pos(_pos), i(_i) {
+            if (pos < list->directory.size()) data = list->readData(pos);
+            skipFinishedBlocks();
+        }
+        // Moves to the next non-empty block if the current one has been finished.
+        void skipFinishedBlocks() {
+            while (pos < list->directory.size() && i == data.size()) {
+                ++pos;
+                i = 0;
+                data.clear();
+                if (pos < list->directory.size()) data = list->readData(pos);
+            }
+            if (pos == list->directory.size()) data.clear();
+        }
+    };
+
     // Initializes BlockList with file_name. Will create a new file if the file doesn't exist.
     void initialise(const std::string& file_name);
     // Inserts (key, value). Do nothing if (key, value) already exists.
@@ -26,19 +86,29 @@ public:
     void erase(const Key& key, const T& value);
     // Returns all values with the given key. Returns empty vectors if no such value exists.
     std::vector<T> query(const Key& key);
+    // Calls func(value) for all values with the given key in ascending order.
+    template <class Func>
+    void query(const Key& key, Func&& func);
+    // Returns the number of values with the given key, counting no more than limit.
+    size_t count(const Key& key, size_t limit);
     // Returns all values in this.
     std::vector<T> queryAll();
     std::vector<std::pair<Key, T>> queryAllKeyValuePairs();
+    // Returns the iterator to the first pair, or to the first pair whose key is not less than key.
+    Iterator begin() { return Iterator(this, 0, 0); }
+    Iterator begin(const Key& key);
+    Iterator end() { return Iterator(this, directory.size(), 0); }
+    // Returns the pairs whose keys are in [lo, hi], reading the blocks as they are iterated.
+    std::ranges::subrange<Iterator> range(const Key& lo, const Key& hi);
+
+    // Sets the memory budget of the page cache of the underlying file. Zero disables the cache.
+    void setCacheCapacity(size_t bytes) { file.setCacheCapacity(bytes); }
+    size_t getCacheHits() const { return file.getCacheHits(); }
+    size_t getCacheMisses() const { return file.getCacheMisses(); }
 
 private:
     // The maximum number of (key, value) that can be stored in a single block
     static constexpr int BLOCK_CAPACITY = 512;
-    // The aggregate struct representing a key-value pair.
-    struct KeyValuePair {
-        Key first;
-        T second;
-        auto operator<=>(const KeyValuePair&) const = default;
-    };
     // The data structure of a block
     struct Block {
         // ==== header part ====
@@ -51,9 +121,20 @@ private:
         KeyValuePair data[BLOCK_CAPACITY + 1];  // one additional space for splitting
     };
 
+    // The in-memory copy of the header of a block.
+    struct BlockInfo {
+        int id;
+        int count;
+        KeyValuePair min_elem;
+        KeyValuePair max_elem;
+    };
+
     // The MemoryRiver that store the data of all blocks.
     // The first an only info stores the starting index of the first block.
-    MemoryRiver<Block, 1> file;
+    MemoryRiver<Block, 1, Storage> file;
+    // The headers of all blocks, in the order of the linked list.
+    // Only a sole block can be empty, because an empty block is always merged into a neighbour.
+    std::vector<BlockInfo> directory;
 
     // Gets or sets the index of first block
     int getFirstHead() {
@@ -81,252 +162,258 @@ private:
     DEFINE_GETTER_AND_SETTER(max_elem);
 #undef DEFINE_GETTER_AND_SETTER
 
-    // Reads a whole block from file.
-    Block getBlock(int block_id);
-    // Writes a whole block to file.
-    void setBlock(int block_id, const Block& block);
-    // Maintains the min and max elem in head data of a block
-    void updateMinMaxElem(Block& b);
+    // Reads the headers of all blocks into directory.
+    void loadDirectory();
+    // Returns the position in directory of the first block whose max_elem is not less than elem,
+    // or directory.size() if there is no such block.
+    int findBlock(const KeyValuePair& elem) const;
+    // Returns the iterator to the first element e with before(e) false. before must be true for a
+    // prefix of the elements.
+    template <class Before>
+    Iterator seek(Before before);
+    // Reads the first count elements of the block directory[pos].
+    std::vector<KeyValuePair> readData(int pos);
+    // Writes elements [begin, end) of data into the same positions of the block directory[pos].
+    void writeData(int pos, const std::vector<KeyValuePair>& data, int begin, int end);
+    // Sets the count and the min/max elements of directory[pos] from data, and writes the changed
+    // fields to the header of the block.
+    void updateHeader(int pos, const std::vector<KeyValuePair>& data);
     // Creates a new block and returns its index.
     int allocateNewBlock();
-    // Splits half the data block_id into a new block.
+    // Splits half the data of the block directory[pos] into a new block.
     // Prerequisite: the block must have at least two elements.
-    void splitBlock(int block_id);
-    // Merges block id1 and id2 together.
-    // Prerequisite: the two blocks must be adjacent and in order id1 -> id2.
-    void mergeBlock(int id1, int id2);
-    // Inserts (key, value) into block_id.
-    void insertInBlock(int block_id, const Key& key, const T& value);
-    // Checks if block id1 and id2 can be merged.
-    bool canMerge(int id1, int id2);
-    // Erases (key, value) in block_id
-    void eraseInBlock(int block_id, const Key& key, const T& value);
-    // Returns all elements in a block whose key is equal to key/
-    std::vector<T> extractInBlock(int block_id, const Key& key);
+    void splitBlock(int pos);
+    // Merges the blocks directory[pos] and directory[pos + 1] together.
+    void mergeBlock(int pos);
+    // Inserts elem into the block directory[pos].
+    void insertInBlock(int pos, const KeyValuePair& elem);
+    // Checks if the blocks directory[pos] and directory[pos + 1] can be merged.
+    bool canMerge(int pos);
+    // Erases elem in the block directory[pos].
+    void eraseInBlock(int pos, const KeyValuePair& elem);
 };
 
-template <class Key, class T>
-void BlockList<Key, T>::initialise(const std::string& file_name) {
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::initialise(const std::string& file_name) {
     file.initialise(file_name);
+    loadDirectory();
 }
-template <class Key, class T>
-void BlockList<Key, T>::insert(const Key& key, const T& value) {
-    if (!getFirstHead()) {  // the blocklist is empty
-        int pos = allocateNewBlock();
-        setFirstHead(pos);
-        insertInBlock(pos, key, value);
-        return;
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::insert(const Key& key, const T& value) {
+    if (directory.empty()) {  // the blocklist is empty
+        int id = allocateNewBlock();
+        setFirstHead(id);
+        directory.push_back(BlockInfo{id, 0, {}, {}});
     }
     auto elem = KeyValuePair{key, value};
-    int block_now = getFirstHead();
-    while (true) {
-        if (get_count(block_now) == 0 || !get_next_head(block_now)) break;
-        if (get_max_elem(block_now) >= elem) break;
-        block_now = get_next_head(block_now);
-    }
-    insertInBlock(block_now, key, value);
-    if (get_count(block_now) >= BLOCK_CAPACITY) {
-        splitBlock(block_now);
+    // insert into the last block if elem is greater than all elements
+    int pos = std::min(findBlock(elem), static_cast<int>(directory.size()) - 1);
+    insertInBlock(pos, elem);
+    if (directory[pos].count >= BLOCK_CAPACITY) {
+        splitBlock(pos);
     }
 }
-template <class Key, class T>
-void BlockList<Key, T>::erase(const Key& key, const T& value) {
-    if (!getFirstHead()) return;  // the block list is empty
-
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::erase(const Key& key, const T& value) {
     auto elem = KeyValuePair{key, value};
-    int block_now = getFirstHead();
-
-    while (block_now) {
-        if (get_count(block_now) == 0 || get_max_elem(block_now) < elem) {
-            block_now = get_next_head(block_now);
-            continue;
-        }
-        if (get_max_elem(block_now) >= elem) {
-            break;
-        }
-    }
-    if (!block_now) return;
+    int pos = findBlock(elem);
+    if (pos == directory.size() || directory[pos].count == 0) return;
     // elem may be in this block
-    eraseInBlock(block_now, key, value);
-
-    int pre = get_prev_head(block_now);
-    int nxt = get_next_head(block_now);
+    eraseInBlock(pos, elem);
 
-    if (pre && canMerge(pre, block_now)) {
-        mergeBlock(pre, block_now);
-    } else if (nxt && canMerge(block_now, nxt)) {
-        mergeBlock(block_now, nxt);
+    if (pos > 0 && canMerge(pos - 1)) {
+        mergeBlock(pos - 1);
+    } else if (pos + 1 < directory.size() && canMerge(pos)) {
+        mergeBlock(pos);
     }
 }
-template <class Key, class T>
-std::vector<T> BlockList<Key, T>::query(const Key& key) {
+template <class Key, class T, class Storage>
+std::vector<T> BlockList<Key, T, Storage>::query(const Key& key) {
     std::vector<T> results;
-
-    if (!getFirstHead()) return results;  // the block list is empty
-
-    int block_now = getFirstHead();
-    // skip useless blocks
-    while (block_now) {
-        if (get_count(block_now) == 0 || get_max_elem(block_now).first < key) {
-            block_now = get_next_head(block_now);
-            continue;
-        }
-        if (get_max_elem(block_now).first >= key) {
-            break;
+    query(key, [&results](const T& value) { results.push_back(value); });
+    return results;
+}
+template <class Key, class T, class Storage>
+template <class Func>
+void BlockList<Key, T, Storage>::query(const Key& key, Func&& func) {
+    // skip the blocks whose elements are all less than key
+    auto it = std::partition_point(directory.begin(), directory.end(),
+                                   [&key](const BlockInfo& b) { return b.max_elem.first < key; });
+    for (; it != directory.end() && it->count; ++it) {
+        if (it->min_elem.first > key) break;
+        const auto data = readData(it - directory.begin());
+        auto first = std::partition_point(
+            data.begin(), data.end(), [&key](const KeyValuePair& e) { return e.first < key; });
+        auto last = std::partition_point(
+            first, data.end(), [&key](const KeyValuePair& e) { return !(key < e.first); });
+        for (; first != last; ++first) {
+            func(first->second);
         }
+        // the following blocks only contain greater keys
+        if (key < it->max_elem.first) break;
     }
-    if (!block_now) return results;  // find no key
-    while (block_now) {
-        if (get_count(block_now) == 0) {
-            block_now = get_next_head(block_now);
-            continue;
-        }
-        if (get_min_elem(block_now).first > key) break;
-        auto results_in_this_block = extractInBlock(block_now, key);
-        for (auto& value : results_in_this_block) {
-            results.push_back(value);
-        }
-        block_now = get_next_head(block_now);
+}
+template <class Key, class T, class Storage>
+size_t BlockList<Key, T, Storage>::count(const Key& key, size_t limit) {
+    size_t result = 0;
+    for (auto it = begin(key), last = end(); result < limit && it != last; ++it) {
+        if (key < (*it).first) break;
+        ++result;
     }
-    return results;
+    return result;
 }
-template <class Key, class T>
-std::vector<T> BlockList<Key, T>::queryAll() {
+template <class Key, class T, class Storage>
+std::vector<T> BlockList<Key, T, Storage>::queryAll() {
     std::vector<T> results;
-    if (!getFirstHead()) return results;  // the block list is empty
-    int block_now = getFirstHead();
-    while (block_now) {
-        const auto& block = getBlock(block_now);
-        for (int i = 0; i < block.count; i++) {
-            results.push_back(block.data[i].second);
+    for (int pos = 0; pos < directory.size(); pos++) {
+        for (const auto& elem : readData(pos)) {
+            results.push_back(elem.second);
         }
-        block_now = get_next_head(block_now);
     }
     return results;
 }
-template <class Key, class T>
-std::vector<std::pair<Key, T>> BlockList<Key, T>::queryAllKeyValuePairs() {
+template <class Key, class T, class Storage>
+std::vector<std::pair<Key, T>> BlockList<Key, T, Storage>::queryAllKeyValuePairs() {
     std::vector<std::pair<Key, T>> results;
-    if (!getFirstHead()) return results;  // the block list is empty
-    int block_now = getFirstHead();
-    while (block_now) {
-        const auto& block = getBlock(block_now);
-        for (int i = 0; i < block.count; i++) {
-            results.emplace_back(block.data[i].first, block.data[i].second);
+    for (int pos = 0; pos < directory.size(); pos++) {
+        for (const auto& elem : readData(pos)) {
+            results.emplace_back(elem.first, elem.second);
         }
-        block_now = get_next_head(block_now);
     }
     return results;
 }
-template <class Key, class T>
-typename BlockList<Key, T>::Block BlockList<Key, T>::getBlock(int block_id) {
-    Block data;
-    file.read(data, block_id);
+template <class Key, class T, class Storage>
+typename BlockList<Key, T, Storage>::Iterator BlockList<Key, T, Storage>::begin(const Key& key) {
+    return seek([&key](const KeyValuePair& e) { return e.first < key; });
+}
+template <class Key, class T, class Storage>
+std::ranges::subrange<typename BlockList<Key, T, Storage>::Iterator>
+BlockList<Key, T, Storage>::range(const Key& lo, const Key& hi) {
+    if (hi < lo) return {end(), end()};
+    return {begin(lo), seek([&hi](const KeyValuePair& e) { return !(hi < e.first); })};
+}
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::loadDirectory() {
+    directory.clear();
+    for (int id = getFirstHead(); id; id = get_next_head(id)) {
+        directory.push_back(BlockInfo{id, get_count(id), get_min_elem(id), get_max_elem(id)});
+    }
+}
+template <class Key, class T, class Storage>
+int BlockList<Key, T, Storage>::findBlock(const KeyValuePair& elem) const {
+    auto it = std::partition_point(directory.begin(), directory.end(),
+                                   [&elem](const BlockInfo& b) { return b.max_elem < elem; });
+    return it - directory.begin();
+}
+template <class Key, class T, class Storage>
+template <class Before>
+typename BlockList<Key, T, Storage>::Iterator BlockList<Key, T, Storage>::seek(Before before) {
+    auto it = std::partition_point(directory.begin(), directory.end(),
+                                   [&before](const BlockInfo& b) { return before(b.max_elem); });
+    Iterator result(this, it - directory.begin(), 0);
+    result.i = std::partition_point(result.data.begin(), result.data.end(), before) -
+               result.data.begin();
+    result.skipFinishedBlocks();
+    return result;
+}
+template <class Key, class T, class Storage>
+std::vector<typename BlockList<Key, T, Storage>::KeyValuePair> BlockList<Key, T, Storage>::readData(
+    int pos) {
+    std::vector<KeyValuePair> data;
+    data.reserve(directory[pos].count + 1);  // leave room for an insertion
+    data.resize(directory[pos].count);
+    file.read(data.data(), directory[pos].id, offsetof(Block, data), data.size());
     return data;
 }
-template <class Key, class T>
-void BlockList<Key, T>::setBlock(int block_id, const Block& block) {
-    file.update(block, block_id);
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::writeData(int pos, const std::vector<KeyValuePair>& data,
+                                           int begin, int end) {
+    if (begin >= end) return;
+    file.update(data.data() + begin, directory[pos].id,
+                offsetof(Block, data) + begin * sizeof(KeyValuePair), end - begin);
 }
-template <class Key, class T>
-void BlockList<Key, T>::updateMinMaxElem(Block& b) {
-    if (!b.count) return;  // don't modify empty block
-    b.min_elem = b.data[0];
-    b.max_elem = b.data[b.count - 1];
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::updateHeader(int pos, const std::vector<KeyValuePair>& data) {
+    auto& info = directory[pos];
+    info.count = data.size();
+    set_count(info.id, info.count);
+    if (data.empty()) return;  // don't modify the min/max elements of an empty block
+    if (info.min_elem != data.front()) {
+        info.min_elem = data.front();
+        set_min_elem(info.id, info.min_elem);
+    }
+    if (info.max_elem != data.back()) {
+        info.max_elem = data.back();
+        set_max_elem(info.id, info.max_elem);
+    }
 }
-template <class Key, class T>
-int BlockList<Key, T>::allocateNewBlock() {
+template <class Key, class T, class Storage>
+int BlockList<Key, T, Storage>::allocateNewBlock() {
     int pos = file.write(Block{});
     return pos;
 }
-template <class Key, class T>
-void BlockList<Key, T>::splitBlock(int block_id) {
-    auto b1 = getBlock(block_id);
-    assert(b1.count >= 2);
-    int mid = b1.count / 2;
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::splitBlock(int pos) {
+    const int block_id = directory[pos].id;
+    auto data = readData(pos);
+    assert(data.size() >= 2);
+    const int mid = data.size() / 2;
 
-    int new_block = allocateNewBlock();
-    auto b2 = getBlock(new_block);
-    // copy the latter part of the data
-    for (int i = mid; i < b1.count; i++) {
-        b2.data[i - mid] = b1.data[i];
-    }
-    // update count
-    b2.count = b1.count - mid;
-    b1.count = mid;
+    const int new_block = allocateNewBlock();
     // update the chain list
-    b2.next_head = b1.next_head;
-    b2.prev_head = block_id;
-    set_prev_head(b1.next_head, new_block);  // also work if h is the last block
-    b1.next_head = new_block;
-    // update the min/max elements
-    updateMinMaxElem(b1);
-    updateMinMaxElem(b2);
-    setBlock(block_id, b1);
-    setBlock(new_block, b2);
+    const int next_block = get_next_head(block_id);
+    set_next_head(new_block, next_block);
+    set_prev_head(new_block, block_id);
+    set_prev_head(next_block, new_block);  // also work if h is the last block
+    set_next_head(block_id, new_block);
+
+    // move the latter part of the data
+    directory.insert(directory.begin() + pos + 1, BlockInfo{new_block, 0, {}, {}});
+    std::vector<KeyValuePair> latter(data.begin() + mid, data.end());
+    data.resize(mid);
+    writeData(pos + 1, latter, 0, latter.size());
+    updateHeader(pos + 1, latter);
+    updateHeader(pos, data);
 }
-template <class Key, class T>
-void BlockList<Key, T>::mergeBlock(int id1, int id2) {
-    auto b1 = getBlock(id1);
-    auto b2 = getBlock(id2);
-    assert(b1.count + b2.count <= BLOCK_CAPACITY);
-    for (int i = b1.count; i < b1.count + b2.count; i++) {
-        b1.data[i] = b2.data[i - b1.count];
-    }
-    b1.count += b2.count;
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::mergeBlock(int pos) {
+    const int id1 = directory[pos].id, id2 = directory[pos + 1].id;
+    auto data = readData(pos);
+    const int count1 = data.size();
+    const auto data2 = readData(pos + 1);
+    assert(count1 + data2.size() <= BLOCK_CAPACITY);
+    data.insert(data.end(), data2.begin(), data2.end());
+    writeData(pos, data, count1, data.size());
 
     // update the chain list (only b1, because b2 will be deleted soon)
-    b1.next_head = b2.next_head;
-    set_prev_head(b2.next_head, id1);
-    // update the min/max elements
-    updateMinMaxElem(b1);
-    setBlock(id1, b1);
+    const int next_block = get_next_head(id2);
+    set_next_head(id1, next_block);
+    set_prev_head(next_block, id1);
+    updateHeader(pos, data);
 
-    // remove b2,b2 from the disk
+    // remove b2 from the disk
     file.erase(id2);
+    directory.erase(directory.begin() + pos + 1);
 }
-template <class Key, class T>
-void BlockList<Key, T>::insertInBlock(int block_id, const Key& key, const T& value) {
-    auto b = getBlock(block_id);
-
-    auto elem = KeyValuePair{key, value};
-    int pos = std::lower_bound(b.data, b.data + b.count, elem) - b.data;
-    for (int i = b.count - 1; i >= pos; --i) {
-        b.data[i + 1] = b.data[i];
-    }
-    b.data[pos] = elem;
-    ++b.count;
-    updateMinMaxElem(b);
-    setBlock(block_id, b);
-}
-template <class Key, class T>
-bool BlockList<Key, T>::canMerge(int id1, int id2) {
-    return get_count(id1) + get_count(id2) < BLOCK_CAPACITY;
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::insertInBlock(int pos, const KeyValuePair& elem) {
+    auto data = readData(pos);
+    const int i = std::lower_bound(data.begin(), data.end(), elem) - data.begin();
+    data.insert(data.begin() + i, elem);
+    writeData(pos, data, i, data.size());
+    updateHeader(pos, data);
 }
-template <class Key, class T>
-void BlockList<Key, T>::eraseInBlock(int block_id, const Key& key, const T& value) {
-    auto b = getBlock(block_id);
-    auto elem = KeyValuePair{key, value};
-    int pos = std::lower_bound(b.data, b.data + b.count, elem) - b.data;
-    if (b.data[pos] != elem) return;
-    for (int i = pos; i < b.count - 1; i++) {
-        b.data[i] = b.data[i + 1];
-    }
-    --b.count;
-    updateMinMaxElem(b);
-    setBlock(block_id, b);
+template <class Key, class T, class Storage>
+bool BlockList<Key, T, Storage>::canMerge(int pos) {
+    return directory[pos].count + directory[pos + 1].count < BLOCK_CAPACITY;
 }
-template <class Key, class T>
-std::vector<T> BlockList<Key, T>::extractInBlock(int block_id, const Key& key) {
-    std::vector<T> results;
-    auto b = getBlock(block_id);
-    for (int i = 0; i < b.count; i++) {
-        auto [k, v] = b.data[i];
-        if (k == key) {
-            results.push_back(v);
-        }
-    }
-    return results;
+template <class Key, class T, class Storage>
+void BlockList<Key, T, Storage>::eraseInBlock(int pos, const KeyValuePair& elem) {
+    auto data = readData(pos);
+    const int i = std::lower_bound(data.begin(), data.end(), elem) - data.begin();
+    if (i == data.size() || data[i] != elem) return;
+    data.erase(data.begin() + i);
+    writeData(pos, data, i, data.size());
+    updateHeader(pos, data);
 }
-
-#endif  // BOOKSTORE_BLOCKLIST_HPP
+#endif  // BOOKSTORE_BLOCKLIST_HPP
\ No newline at end of file
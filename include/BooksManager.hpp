@@ -1,10 +1,24 @@
 #ifndef BOOKSTORE_BOOKSMANAGER_HPP
 #define BOOKSTORE_BOOKSMANAGER_HPP
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <shared_mutex>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-#include "BlockList.hpp"
+#include "BPlusTree.hpp"
+#include "HashIndex.hpp"
+#include "InvertedIndex.hpp"
+#include "SharedMutex.hpp"
+#include "SnapshotMap.hpp"
 
 // The data structure for a book
 struct Book {
@@ -32,7 +46,53 @@ struct Book {
     bool operator==(const Book&) const = default;
 };
 
+// A conjunctive query on books: a book matches if it satisfies all the given conditions.
+struct BookQuery {
+    std::optional<Book::ISBN_T> ISBN;
+    std::optional<Book::BOOKNAME_T> name;
+    std::optional<Book::AUTHOR_T> author;
+    // The book must have all of these keywords.
+    std::vector<Book::KEYWORD_T> keywords;
+    // If not empty, the book must have at least one of these keywords.
+    std::vector<Book::KEYWORD_T> any_keywords;
+    // The book must have none of these keywords.
+    std::vector<Book::KEYWORD_T> excluded_keywords;
+    // The name or the author must contain these strings.
+    std::optional<Book::BOOKNAME_T> name_contains;
+    std::optional<Book::AUTHOR_T> author_contains;
+    // The price and the quantity must be within these bounds, inclusive.
+    std::optional<long long> min_price, max_price;
+    std::optional<int> min_quantity, max_quantity;
+
+    bool empty() const {
+        return !ISBN && !name && !author && keywords.empty() && any_keywords.empty() &&
+               excluded_keywords.empty() && !name_contains && !author_contains && !min_price &&
+               !max_price && !min_quantity && !max_quantity;
+    }
+};
+
+// A page of the books in the order of ascending ISBN: at most limit books whose ISBNs are greater
+// than after, or from the first book if after is not given.
+struct BookPage {
+    std::optional<Book::ISBN_T> after;
+    size_t limit = std::numeric_limits<size_t>::max();
+};
+
+// The outcome of BooksManager::tryBuy().
+struct Purchase {
+    enum Status { SUCCESS, NO_BOOK, OUT_OF_STOCK } status = NO_BOOK;
+    // The unit price of the book, and the quantity left after the purchase.
+    long long price = 0;
+    int quantity = 0;
+};
+
 // A singleton class that provides methods to manipulate the data of books.
+//
+// It may be used from several threads at once: queries run concurrently, and a modification
+// excludes everything else, so that a book and its index entries always change together.
+// Purchases only change the quantity of a book, and run concurrently with the queries and with the
+// purchases of other books.
+// With enableSnapshots(), lookups by ISBN alone don't wait for modifications either.
 class BooksManager {
 public:
     // Returns the singleton for BooksManager.
@@ -47,17 +107,55 @@ public:
     std::vector<Book> getBooksWithAuthor(const Book::AUTHOR_T& author);
     std::vector<Book> getBooksWithKeyword(const Book::KEYWORD_T& keyword);
     std::vector<Book> getAllBooks();
+    // Calls func(book) for all books, or for the books with the given name, author or keyword, in
+    // the order of ascending ISBN. The books are read one at a time as they are passed to func.
+    // func is called while the books are locked for reading, so it must not modify books.
+    template <class Func>
+    void forEachBook(Func&& func);
+    template <class Func>
+    void forEachBookWithName(const Book::BOOKNAME_T& name, Func&& func) {
+        std::shared_lock lock(mutex);
+        forEachBookByIds(book_name_index.query(name), func);
+    }
+    template <class Func>
+    void forEachBookWithAuthor(const Book::AUTHOR_T& author, Func&& func) {
+        std::shared_lock lock(mutex);
+        forEachBookByIds(author_index.query(author), func);
+    }
+    template <class Func>
+    void forEachBookWithKeyword(const Book::KEYWORD_T& keyword, Func&& func) {
+        std::shared_lock lock(mutex);
+        forEachBookByIds(keyword_index.query(keyword), func);
+    }
+    // Calls func(book) for the books matching query in the order of ascending ISBN. All books
+    // match an empty query. Only the books in page are passed. Returns true if more books match
+    // after the page, in which case the ISBN of the last book passed continues it.
+    // Without a query, a page is read from isbn_index starting at its cursor, so its cost doesn't
+    // depend on the pages before it.
+    template <class Func>
+    bool forEachBookMatching(const BookQuery& query, Func&& func, const BookPage& page = {});
 
     // Creates a new book with only the info of ISBN.
     // The ISBN SHALL not exist before.
     void createBook(const Book::ISBN_T& ISBN);
 
-    // Modify the data of the book with data_new
+    // Modify the data of the book with data_new. The record is updated in place, and only the
+    // indexes whose keys changed are updated. Throws std::runtime_error if the ISBN is changed to
+    // one that already exists, in which case nothing is modified.
     void modifyBookData(const Book::ISBN_T& ISBN_before, const Book& data_new);
     void importBook(const Book::ISBN_T& ISBN, int quantity);
+    // Buys quantity copies of the book if there are enough of them. The book is looked up once,
+    // and the check and the decrement happen together under the lock of the book, so concurrent
+    // purchases never oversell.
+    // Nothing is modified unless the status of the result is SUCCESS.
+    Purchase tryBuy(const Book::ISBN_T& ISBN, int quantity);
     // Returns true if the operation is success.
     bool buyBook(const Book::ISBN_T& ISBN, int quantity);
 
+    // Keeps the latest version of every book in memory, so that the lookups by ISBN alone read
+    // them without locks. Modifications publish new versions of the books they change.
+    void enableSnapshots();
+
     // Helper function for testing.
     void reset();
     // get a book by id
@@ -67,22 +165,168 @@ public:
     // Returns the id of a book by ISBN. Returns 0 if no such book exists.
     int getIdByISBN(const Book::ISBN_T& ISBN);
 
+    // The key of the n-gram index: the tag of a field followed by NGRAM_LEN consecutive bytes of
+    // the field.
+    typedef std::array<char, 4> NGRAM_T;
+    static constexpr size_t NGRAM_LEN = 3;
+    static constexpr char NAME_NGRAM = 'n';
+    static constexpr char AUTHOR_NGRAM = 'a';
+    // Returns the distinct n-grams of text in ascending order.
+    static std::vector<NGRAM_T> getNgrams(char field, std::string_view text);
+
 private:
+    // Shared by queries and purchases, and held exclusively by the other modifications. The
+    // private functions below expect the caller to hold it.
+    SharedMutex mutex;
+    // A purchase of book id also holds purchase_mutexes[id % PURCHASE_STRIPES], so that the
+    // purchases of a book are serialized while those of different books run in parallel. Reading
+    // the whole record of book id takes the stripe as well, so that the read never overlaps the
+    // quantity being written.
+    static constexpr size_t PURCHASE_STRIPES = 64;
+    std::array<std::mutex, PURCHASE_STRIPES> purchase_mutexes;
+    // Held exclusively by purchases while they move a book in quantity_index, and shared by the
+    // queries reading quantity_index. The other modifications need not take it. It is taken after
+    // a purchase stripe, so a query must not read a book while holding it.
+    SharedMutex quantity_mutex;
+    // The latest versions of the books by ISBN, if snapshots are enabled. Modified while holding
+    // mutex exclusively, or by purchases holding snapshots_mutex, and read without locks.
+    std::atomic<bool> snapshots_enabled = false;
+    std::mutex snapshots_mutex;
+    SnapshotMap<Book, &Book::ISBN> snapshots;
     // The primary data for all books
-    MemoryRiver<Book, 0> main_data;
+    MemoryRiver<Book, 0, MappedFile> main_data;
+    // The container of the indexes. BlockList can be used here as well, but the index files are not
+    // compatible; tools/migrateIndex.cpp converts the files from BlockList.
+    template <class Key>
+    using Index = BPlusTree<Key, int, MappedFile>;
     // Indexes for quickly searching books.
-    BlockList<Book::ISBN_T, int> isbn_index;
-    BlockList<Book::BOOKNAME_T, int> book_name_index;
-    BlockList<Book::AUTHOR_T, int> author_index;
-    // Note: only one keyword is stored in each key-value pair
-    BlockList<Book::KEYWORD_T, int> keyword_index;
-
-    // Helper function for erasing all data and indexes of the book
-    void removeData(const Book::ISBN_T& ISBN);
+    // ISBNs are unique, so point lookups go to the hash index; isbn_index keeps them in order.
+    HashIndex<Book::ISBN_T, int, MappedFile> isbn_hash;
+    Index<Book::ISBN_T> isbn_index;
+    Index<Book::BOOKNAME_T> book_name_index;
+    Index<Book::AUTHOR_T> author_index;
+    // Ordered by price and by quantity, for range queries and low-stock sweeps.
+    Index<long long> price_index;
+    Index<int> quantity_index;
+    // Each keyword maps to the ids of the books with it, so that a keyword shared by many books is
+    // stored once and boolean keyword queries merge the compressed lists.
+    InvertedIndex<Book::KEYWORD_T, MappedFile> keyword_index;
+    // The n-grams of the names and the authors, for substring queries. The n-grams of a string give
+    // the candidates, which are verified on their records.
+    InvertedIndex<NGRAM_T, MappedFile> ngram_index;
+
+    // A query matching at least 1 / MERGE_SCAN_RATIO of all books is answered by scanning
+    // isbn_index for the matching ids. A smaller one is answered by sorting the ISBNs of the
+    // matches.
+    static constexpr size_t MERGE_SCAN_RATIO = 16;
+
+    // The number of index entries counted to estimate how many books a condition matches.
+    static constexpr size_t ESTIMATE_LIMIT = 1024;
+    // A condition matching at least FILTER_RATIO times as many books as the candidates found so
+    // far is checked on the records of the candidates instead of being looked up in its index.
+    static constexpr size_t FILTER_RATIO = 8;
+
+    // Returns the ids of the books matching a non-empty query in ascending order.
+    // The condition estimated to be the most selective is looked up first, and the id lists of the
+    // others are intersected with it, or they are checked on the records if there are few
+    // candidates left.
+    std::vector<int> findIds(const BookQuery& query);
+    // Calls func(book) for the books with the given ids in page in the order of ascending ISBN.
+    // Returns true if more books follow the page.
+    template <class Func>
+    bool forEachBookByIds(std::vector<int> ids, Func&& func, const BookPage& page = {});
     // Helper function for writing all data and indexes of a book.
     void writeData(const Book& book);
+    // Updates the n-grams of a field of book id, whose value is changed from before to after.
+    void updateNgrams(char field, std::string_view before, std::string_view after, int id);
+    // Returns the ids of all books in ascending order.
+    std::vector<int> getAllIds();
+    // Unlocked versions of getBookById() and getIdByISBN(). readBook still takes the purchase stripe
+    // of the book.
+    Book readBook(int id);
+    int findId(const Book::ISBN_T& ISBN);
+    // Publishes the version of book id on disk to the snapshots, if they are enabled.
+    void publish(int id);
+    // Returns true if the query is answered by the snapshots.
+    bool isSnapshotLookup(const BookQuery& query) const;
     BooksManager();
     ~BooksManager() = default;
 };
 
+inline std::vector<BooksManager::NGRAM_T> BooksManager::getNgrams(char field,
+                                                                  std::string_view text) {
+    std::vector<NGRAM_T> ngrams;
+    for (size_t i = 0; i + NGRAM_LEN <= text.size(); i++) {
+        NGRAM_T ngram{field};
+        std::ranges::copy(text.substr(i, NGRAM_LEN), ngram.begin() + 1);
+        ngrams.push_back(ngram);
+    }
+    std::ranges::sort(ngrams);
+    ngrams.erase(std::ranges::unique(ngrams).begin(), ngrams.end());
+    return ngrams;
+}
+template <class Func>
+void BooksManager::forEachBook(Func&& func) {
+    forEachBookMatching(BookQuery{}, func);
+}
+template <class Func>
+bool BooksManager::forEachBookMatching(const BookQuery& query, Func&& func, const BookPage& page) {
+    if (isSnapshotLookup(query)) {
+        const auto book = snapshots.find(*query.ISBN);
+        if (!book || (page.after && book->ISBN <= *page.after)) return false;
+        if (page.limit == 0) return true;
+        func(*book);
+        return false;
+    }
+    std::shared_lock lock(mutex);
+    if (!query.empty()) return forEachBookByIds(findIds(query), func, page);
+    size_t count = 0;
+    auto it = page.after ? isbn_index.begin(*page.after) : isbn_index.begin();
+    for (const auto last = isbn_index.end(); it != last; ++it) {
+        const auto [ISBN, id] = *it;
+        if (page.after && ISBN == *page.after) continue;
+        if (count++ == page.limit) return true;
+        func(readBook(id));
+    }
+    return false;
+}
+template <class Func>
+bool BooksManager::forEachBookByIds(std::vector<int> ids, Func&& func, const BookPage& page) {
+    std::ranges::sort(ids);
+    ids.erase(std::ranges::unique(ids).begin(), ids.end());
+    size_t count = 0;
+    if (ids.size() * MERGE_SCAN_RATIO >= isbn_hash.size()) {
+        // merge the sorted ids with isbn_index, which is already in the order of ISBN
+        size_t remaining = ids.size();
+        auto it = page.after ? isbn_index.begin(*page.after) : isbn_index.begin();
+        for (const auto last = isbn_index.end(); remaining && it != last; ++it) {
+            const auto [ISBN, id] = *it;
+            if (page.after && ISBN == *page.after) continue;
+            if (!std::ranges::binary_search(ids, id)) continue;
+            if (count++ == page.limit) return true;
+            func(readBook(id));
+            --remaining;
+        }
+        return false;
+    }
+    // only the ISBNs are read and sorted, and the books are read when they are passed
+    std::vector<std::pair<Book::ISBN_T, int>> keys;
+    keys.reserve(ids.size());
+    for (const int id : ids) {
+        Book::ISBN_T ISBN;
+        main_data.read(ISBN, id, offsetof(Book, ISBN));
+        keys.emplace_back(ISBN, id);
+    }
+    std::ranges::sort(keys);
+    auto it = keys.begin();
+    if (page.after) {
+        it = std::ranges::upper_bound(keys, *page.after, {}, &std::pair<Book::ISBN_T, int>::first);
+    }
+    for (; it != keys.end(); ++it) {
+        if (count++ == page.limit) return true;
+        func(readBook(it->second));
+    }
+    return false;
+}
+
 #endif  // BOOKSTORE_BOOKSMANAGER_HPP
@@ -1,6 +1,8 @@
 #ifndef BOOKSTORE_BOOKCOMMANDS_HPP
 #define BOOKSTORE_BOOKCOMMANDS_HPP
+#include <functional>
 #include <optional>
+#include <vector>
 
 #include "CommandBase.hpp"
 
@@ -14,17 +16,34 @@
 
 class ShowCommand : public Command {
 public:
-    void execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) override;
+    void run(ExecutionContext& ctx, std::ostream& os) override;
+    // Runs the command as run does, but passes the books to func in the order of ascending
+    // ISBN instead of printing them. Returns true if more books follow the page.
+    bool forEachResult(ExecutionContext& ctx, const std::function<void(const Book&)>& func);
     ShowCommand() = default;
     std::optional<Book::ISBN_T> ISBN;
     std::optional<Book::BOOKNAME_T> name;
     std::optional<Book::AUTHOR_T> author;
-    std::optional<Book::KEYWORD_T> keyword;
+    // The books must have all of these keywords. The command line gives at most one.
+    std::vector<Book::KEYWORD_T> keywords;
+    // The keyword conditions of BookQuery that only the server gives.
+    std::vector<Book::KEYWORD_T> any_keywords;
+    std::vector<Book::KEYWORD_T> excluded_keywords;
+    std::optional<Book::BOOKNAME_T> name_contains;
+    std::optional<Book::AUTHOR_T> author_contains;
+    std::optional<long long> min_price, max_price;
+    std::optional<int> min_quantity, max_quantity;
+    // The page of the books to show. The command line shows all of them.
+    BookPage page;
+
+private:
+    // Logs and runs the query, with the current user of ctx read already.
+    bool forEach(const ExecutionContext& ctx, const std::function<void(const Book&)>& func);
 };
 
 class BuyCommand : public Command {
 public:
-    void execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) override;
+    void run(ExecutionContext& ctx, std::ostream& os) override;
     BuyCommand(const Book::ISBN_T& _ISBN, int _quantity);
 
 private:
@@ -34,7 +53,7 @@ private:
 
 class SelectCommand : public Command {
 public:
-    void execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) override;
+    void run(ExecutionContext& ctx, std::ostream& os) override;
     SelectCommand(const Book::ISBN_T& _ISBN);
 
 private:
@@ -43,7 +62,7 @@ private:
 
 class ModifyCommand : public Command {
 public:
-    void execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) override;
+    void run(ExecutionContext& ctx, std::ostream& os) override;
     ModifyCommand() = default;
     std::optional<Book::ISBN_T> new_ISBN;
     std::optional<Book::BOOKNAME_T> new_name;
@@ -54,7 +73,7 @@ public:
 
 class ImportCommand : public Command {
 public:
-    void execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) override;
+    void run(ExecutionContext& ctx, std::ostream& os) override;
     ImportCommand(int _quantity, long long _total_cost);
 
 private:
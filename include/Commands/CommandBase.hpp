@@ -7,6 +7,7 @@
 #include "BooksManager.hpp"
 #include "LogManager.hpp"
 #include "UsersManager.hpp"
+#include "Utils.hpp"
 
 class ExecutionException : public std::exception {
 public:
@@ -17,15 +18,44 @@ private:
     std::string message;
 };
 
+// The session that a command runs in: the user logged in and the book selected.
+struct ExecutionContext {
+    // Only the userid of the user is kept between commands. execute() reads the rest once before
+    // the command runs, so that the command needn't look the user up again.
+    User user;
+    // The id of the selected book, or 0 if none is selected.
+    int selected_id = 0;
+
+    // A session of the guest user, with no book selected.
+    ExecutionContext() : ExecutionContext(util::toArray<User::USERID_T>("<GUEST>")) {}
+    explicit ExecutionContext(const User::USERID_T& userid, int _selected_id = 0)
+        : selected_id(_selected_id) {
+        user.userid = userid;
+    }
+    const User::USERID_T& userid() const { return user.userid; }
+    int privilege() const { return user.privilege; }
+};
+
 class Command {
 public:
+    // Reads the current user of ctx, and runs the command as one transaction of the
+    // WriteAheadLog, so that its writes are committed together and are durable when it returns.
     // May throws ExecutionException
-    virtual void execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) = 0;
+    void execute(ExecutionContext& ctx, std::ostream& os);
+    // The command itself, which execute() runs.
+    virtual void run(ExecutionContext& ctx, std::ostream& os) = 0;
     virtual ~Command() = default;
 
 protected:
-    static UsersManager& usr_mgr;
-    static BooksManager& bk_mgr;
-    static LogManager& log_mgr;
+    // The managers are looked up on first use rather than during static initialization, so that
+    // the WriteAheadLog can be opened before they open their files.
+    static UsersManager& usr_mgr() { return UsersManager::getInstance(); }
+    static BooksManager& bk_mgr() { return BooksManager::getInstance(); }
+    static LogManager& log_mgr() { return LogManager::getInstance(); }
+
+    // Reads the current user of ctx from its userid.
+    static void resolveUser(ExecutionContext& ctx) {
+        ctx.user = usr_mgr().getUserByUserid(ctx.userid());
+    }
 };
 #endif  // BOOKSTORE_COMMANDS_HPP
@@ -0,0 +1,334 @@
+#ifndef BOOKSTORE_HASHINDEX_HPP
+#define BOOKSTORE_HASHINDEX_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MemoryRiver.hpp"
+
+// A persistent map from unique keys to values, based on linear hashing. Point lookups take expected
+// constant time, but unlike BlockList the keys are not ordered.
+//
+// Buckets are added one at a time: whenever the load factor exceeds MAX_LOAD percent, the bucket at
+// the split pointer is split into itself and a new bucket. A bucket that fills up before its turn
+// is extended with a chain of overflow buckets. The table from bucket numbers to bucket indexes is
+// kept in memory, and stored in the same file as a chain of table pages.
+//
+// Every bucket also stores a one-byte tag taken from the hash of each key, so a lookup only reads
+// the tags and the few elements whose tags match.
+//
+// Template Args:
+//   Key: The type of the key. Must be comparable using operator== and be POD without padding,
+//        since the hash is computed on the bytes of the key.
+//   T: The type of the value. Must be POD.
+//   Storage: The file backend of the underlying MemoryRiver. Default set to PagedFile.
+template <class Key, class T, class Storage = PagedFile>
+class HashIndex {
+    static_assert(std::has_unique_object_representations_v<Key>, "Key must not have padding");
+
+public:
+    // Initializes HashIndex with file_name. Will create a new file if the file doesn't exist.
+    void initialise(const std::string& file_name);
+    // Inserts (key, value). Returns false and does nothing if key already exists.
+    bool insert(const Key& key, const T& value);
+    // Erases key. Returns false if key doesn't exist.
+    bool erase(const Key& key);
+    // Replaces the value of key. Returns false and does nothing if key doesn't exist.
+    bool update(const Key& key, const T& value);
+    // Returns the value of key, or std::nullopt if no such key exists.
+    std::optional<T> find(const Key& key);
+    bool contains(const Key& key) { return find(key).has_value(); }
+    // Returns the number of keys stored.
+    int size() const { return element_count; }
+
+    // Sets the memory budget of the page cache of the underlying file. Zero disables the cache.
+    void setCacheCapacity(size_t bytes) { file.setCacheCapacity(bytes); }
+    size_t getCacheHits() const { return file.getCacheHits(); }
+    size_t getCacheMisses() const { return file.getCacheMisses(); }
+
+private:
+    // The aggregate struct representing a key-value pair.
+    struct KeyValuePair {
+        Key first;
+        T second;
+    };
+
+    // The capacity is chosen so that a bucket fits in a page.
+    static constexpr int BUCKET_CAPACITY =
+        std::max<int>(4, (PagedFile::PAGE_SIZE - 2 * sizeof(int)) / (sizeof(KeyValuePair) + 1));
+    static constexpr int MAX_LOAD = 75;
+
+    // The data structure of a bucket
+    struct Bucket {
+        int count;     // the number of elements in the bucket
+        int overflow;  // the index of the next overflow bucket, or 0
+        uint8_t tags[BUCKET_CAPACITY];
+        KeyValuePair data[BUCKET_CAPACITY];
+    };
+    // A table page takes the space of a bucket, storing the index of the next table page followed
+    // by the indexes of TABLE_PAGE_ENTRIES buckets.
+    static constexpr int TABLE_PAGE_ENTRIES = sizeof(Bucket) / sizeof(int) - 1;
+
+    // The MemoryRiver that store the buckets and the table pages.
+    // The infos are the number of buckets, the number of elements and the first table page.
+    MemoryRiver<Bucket, 3, Storage> file;
+    int element_count = 0;
+    // The index of the primary bucket of each bucket number.
+    std::vector<int> buckets;
+    // The indexes of the table pages.
+    std::vector<int> table_pages;
+
+    // A bucket in a chain loaded in memory.
+    struct Page {
+        int id;
+        std::vector<uint8_t> tags;
+        std::vector<KeyValuePair> data;
+    };
+
+    static uint64_t hash(const Key& key);
+    // The tag uses the high bits of the hash, as the low bits are the same within a bucket.
+    static uint8_t tagOf(uint64_t h) { return h >> 56; }
+    // Returns the bucket number of a hash value with the current number of buckets.
+    int bucketOf(uint64_t h) const;
+    // Reads the count and overflow of the bucket at index.
+    void readHeader(int index, int& count, int& overflow);
+    // Returns the position of key in the bucket at index with count elements, or -1 if not found.
+    int findInBucket(int index, int count, const Key& key, uint8_t tag);
+    // Finds the bucket index and the position of key. Returns false if not found.
+    bool locate(const Key& key, int& index, int& pos);
+    // Reads the elements of the chain of bucket number b.
+    std::vector<Page> readChain(int b);
+    // Writes elements into the chain of buckets at ids, allocating or freeing overflow buckets
+    // as needed. ids[0] is the primary bucket.
+    void writeChain(std::vector<int> ids, const std::vector<KeyValuePair>& elements);
+    // Creates a new bucket number with an empty primary bucket.
+    void appendBucket();
+    // Splits the bucket at the split pointer.
+    void split();
+};
+
+template <class Key, class T, class Storage>
+void HashIndex<Key, T, Storage>::initialise(const std::string& file_name) {
+    file.initialise(file_name);
+    int bucket_count, table_page;
+    file.getInfo(bucket_count, 1);
+    file.getInfo(element_count, 2);
+    file.getInfo(table_page, 3);
+    buckets.clear();
+    table_pages.clear();
+    while (buckets.size() < bucket_count) {
+        table_pages.push_back(table_page);
+        std::vector<int> page(TABLE_PAGE_ENTRIES + 1);
+        file.read(page.data(), table_page, 0, page.size());
+        const int n = std::min<int>(TABLE_PAGE_ENTRIES, bucket_count - buckets.size());
+        buckets.insert(buckets.end(), page.begin() + 1, page.begin() + 1 + n);
+        table_page = page[0];
+    }
+    if (buckets.empty()) appendBucket();
+}
+template <class Key, class T, class Storage>
+bool HashIndex<Key, T, Storage>::insert(const Key& key, const T& value) {
+    const uint64_t h = hash(key);
+    int id = buckets[bucketOf(h)];
+    while (true) {
+        int count, overflow;
+        readHeader(id, count, overflow);
+        if (findInBucket(id, count, key, tagOf(h)) >= 0) return false;
+        if (overflow) {
+            id = overflow;
+            continue;
+        }
+        const auto elem = KeyValuePair{key, value};
+        if (count < BUCKET_CAPACITY) {
+            file.update(elem, id, offsetof(Bucket, data) + count * sizeof(KeyValuePair));
+            file.update(tagOf(h), id, offsetof(Bucket, tags) + count);
+            file.update(count + 1, id, offsetof(Bucket, count));
+        } else {  // the last bucket in the chain is full
+            Bucket bucket{};
+            bucket.count = 1;
+            bucket.tags[0] = tagOf(h);
+            bucket.data[0] = elem;
+            file.update(file.write(bucket), id, offsetof(Bucket, overflow));
+        }
+        break;
+    }
+    file.writeInfo(++element_count, 2);
+    if (element_count * 100LL > buckets.size() * 1LL * BUCKET_CAPACITY * MAX_LOAD) {
+        split();
+    }
+    return true;
+}
+template <class Key, class T, class Storage>
+bool HashIndex<Key, T, Storage>::erase(const Key& key) {
+    auto chain = readChain(bucketOf(hash(key)));
+    for (auto& page : chain) {
+        auto it = std::find_if(page.data.begin(), page.data.end(),
+                               [&key](const KeyValuePair& e) { return e.first == key; });
+        if (it == page.data.end()) continue;
+        // fill the hole with the last element of the chain
+        auto& last = chain.back();
+        if (&*it != &last.data.back()) {
+            const int pos = it - page.data.begin();
+            *it = last.data.back();
+            page.tags[pos] = last.tags.back();
+            file.update(*it, page.id, offsetof(Bucket, data) + pos * sizeof(KeyValuePair));
+            file.update(page.tags[pos], page.id, offsetof(Bucket, tags) + pos);
+        }
+        last.data.pop_back();
+        last.tags.pop_back();
+        if (last.data.empty() && chain.size() > 1) {  // drop the empty overflow bucket
+            file.update(0, chain[chain.size() - 2].id, offsetof(Bucket, overflow));
+            file.erase(last.id);
+        } else {
+            file.update(static_cast<int>(last.data.size()), last.id, offsetof(Bucket, count));
+        }
+        file.writeInfo(--element_count, 2);
+        return true;
+    }
+    return false;
+}
+template <class Key, class T, class Storage>
+bool HashIndex<Key, T, Storage>::update(const Key& key, const T& value) {
+    int id, pos;
+    if (!locate(key, id, pos)) return false;
+    file.update(value, id,
+                offsetof(Bucket, data) + pos * sizeof(KeyValuePair) +
+                    offsetof(KeyValuePair, second));
+    return true;
+}
+template <class Key, class T, class Storage>
+std::optional<T> HashIndex<Key, T, Storage>::find(const Key& key) {
+    int id, pos;
+    if (!locate(key, id, pos)) return std::nullopt;
+    T value;
+    file.read(value, id,
+              offsetof(Bucket, data) + pos * sizeof(KeyValuePair) + offsetof(KeyValuePair, second));
+    return value;
+}
+template <class Key, class T, class Storage>
+uint64_t HashIndex<Key, T, Storage>::hash(const Key& key) {
+    // FNV-1a, followed by the finalizer of splitmix64 to mix the bytes into the low bits
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&key);
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(Key); i++) {
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+    }
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+template <class Key, class T, class Storage>
+int HashIndex<Key, T, Storage>::bucketOf(uint64_t h) const {
+    const uint64_t level_size = std::bit_floor(buckets.size());
+    const uint64_t b = h & (level_size - 1);
+    // the buckets before the split pointer have been split with one more bit
+    if (b < buckets.size() - level_size) return h & (level_size * 2 - 1);
+    return b;
+}
+template <class Key, class T, class Storage>
+void HashIndex<Key, T, Storage>::readHeader(int index, int& count, int& overflow) {
+    int header[2];
+    file.read(header, index, offsetof(Bucket, count), 2);
+    count = header[0];
+    overflow = header[1];
+}
+template <class Key, class T, class Storage>
+int HashIndex<Key, T, Storage>::findInBucket(int index, int count, const Key& key, uint8_t tag) {
+    std::vector<uint8_t> tags(count);
+    file.read(tags.data(), index, offsetof(Bucket, tags), count);
+    for (int i = 0; i < count; i++) {
+        if (tags[i] != tag) continue;
+        Key candidate;
+        file.read(candidate, index, offsetof(Bucket, data) + i * sizeof(KeyValuePair));
+        if (candidate == key) return i;
+    }
+    return -1;
+}
+template <class Key, class T, class Storage>
+bool HashIndex<Key, T, Storage>::locate(const Key& key, int& index, int& pos) {
+    const uint64_t h = hash(key);
+    for (index = buckets[bucketOf(h)]; index;) {
+        int count, overflow;
+        readHeader(index, count, overflow);
+        pos = findInBucket(index, count, key, tagOf(h));
+        if (pos >= 0) return true;
+        index = overflow;
+    }
+    return false;
+}
+template <class Key, class T, class Storage>
+std::vector<typename HashIndex<Key, T, Storage>::Page> HashIndex<Key, T, Storage>::readChain(
+    int b) {
+    std::vector<Page> chain;
+    int id = buckets[b];
+    while (id) {
+        int count, overflow;
+        readHeader(id, count, overflow);
+        chain.push_back(Page{id, std::vector<uint8_t>(count), std::vector<KeyValuePair>(count)});
+        file.read(chain.back().tags.data(), id, offsetof(Bucket, tags), count);
+        file.read(chain.back().data.data(), id, offsetof(Bucket, data), count);
+        id = overflow;
+    }
+    return chain;
+}
+template <class Key, class T, class Storage>
+void HashIndex<Key, T, Storage>::writeChain(std::vector<int> ids,
+                                            const std::vector<KeyValuePair>& elements) {
+    const int pages = std::max<int>(1, (elements.size() + BUCKET_CAPACITY - 1) / BUCKET_CAPACITY);
+    while (ids.size() < pages) ids.push_back(file.write(Bucket{}));
+    for (int i = pages; i < ids.size(); i++) file.erase(ids[i]);
+    for (int i = 0; i < pages; i++) {
+        const int begin = i * BUCKET_CAPACITY;
+        const int count = std::min<int>(BUCKET_CAPACITY, elements.size() - begin);
+        const int header[2] = {count, i + 1 < pages ? ids[i + 1] : 0};
+        std::vector<uint8_t> tags(count);
+        for (int j = 0; j < count; j++) tags[j] = tagOf(hash(elements[begin + j].first));
+        file.update(header, ids[i], offsetof(Bucket, count), 2);
+        file.update(tags.data(), ids[i], offsetof(Bucket, tags), count);
+        file.update(elements.data() + begin, ids[i], offsetof(Bucket, data), count);
+    }
+}
+template <class Key, class T, class Storage>
+void HashIndex<Key, T, Storage>::appendBucket() {
+    const int id = file.write(Bucket{});
+    const int pos = buckets.size();
+    if (pos % TABLE_PAGE_ENTRIES == 0) {  // the table pages are full
+        const int page = file.write(Bucket{});
+        if (table_pages.empty()) {
+            file.writeInfo(page, 3);
+        } else {
+            file.update(page, table_pages.back(), 0);
+        }
+        table_pages.push_back(page);
+    }
+    file.update(id, table_pages.back(), (1 + pos % TABLE_PAGE_ENTRIES) * sizeof(int));
+    buckets.push_back(id);
+    file.writeInfo(buckets.size(), 1);
+}
+template <class Key, class T, class Storage>
+void HashIndex<Key, T, Storage>::split() {
+    const int level_size = std::bit_floor(buckets.size());
+    const int from = buckets.size() - level_size;
+    const int to = buckets.size();
+    std::vector<int> ids;
+    std::vector<KeyValuePair> stay, move;
+    for (const auto& page : readChain(from)) {
+        ids.push_back(page.id);
+        for (const auto& elem : page.data) {
+            (static_cast<int>(hash(elem.first) & (level_size * 2 - 1)) == to ? move : stay)
+                .push_back(elem);
+        }
+    }
+    appendBucket();
+    writeChain(ids, stay);
+    writeChain({buckets[to]}, move);
+}
+
+#endif  // BOOKSTORE_HASHINDEX_HPP
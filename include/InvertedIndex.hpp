@@ -0,0 +1,409 @@
+#ifndef BOOKSTORE_INVERTEDINDEX_HPP
+#define BOOKSTORE_INVERTEDINDEX_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HashIndex.hpp"
+#include "MemoryRiver.hpp"
+
+// A persistent map from keys to sorted lists of distinct positive ids (posting lists). It suits
+// indexes where many ids share a key, such as the keywords of books.
+//
+// The distinct keys form a dictionary in a HashIndex, which stores the length and the first chunk
+// of each list. A list of a single id stores the id in the dictionary instead. Longer lists are
+// linked lists of fixed-size chunks, where the ids are stored as varint-encoded gaps. The header of
+// a chunk records its first and last ids, so a Cursor skips the chunks before a target without
+// decoding them.
+//
+// Template Args:
+//   Key: The type of the key, with the same requirements as the key of HashIndex.
+//   Storage: The file backend. Default set to PagedFile.
+template <class Key, class Storage = PagedFile>
+class InvertedIndex {
+public:
+    // Initializes InvertedIndex. The dictionary is stored in file_name and the chunks in
+    // file_name + "_postings". Will create new files if the files don't exist.
+    void initialise(const std::string& file_name);
+    // Inserts id into the list of key. Does nothing if it is already there.
+    void insert(const Key& key, int id);
+    // Erases id from the list of key. Does nothing if it isn't there.
+    void erase(const Key& key, int id);
+    // Returns the list of key in ascending order.
+    std::vector<int> query(const Key& key);
+    // Returns the ids in the lists of all keys in all_of, in the list of at least one key in
+    // any_of, and in none of the lists of the keys in none_of, in ascending order. An empty any_of
+    // puts no restriction. all_of and any_of must not both be empty.
+    std::vector<int> query(const std::vector<Key>& all_of, const std::vector<Key>& any_of,
+                           const std::vector<Key>& none_of = {});
+    // Returns the length of the list of key.
+    size_t count(const Key& key);
+    // Fills an empty InvertedIndex with pairs, which must be sorted and unique.
+    // The chunks are filled up, so that the lists take the least space.
+    void bulkLoad(const std::vector<std::pair<Key, int>>& pairs);
+
+    // Sets the memory budget of the page caches of the underlying files.
+    void setCacheCapacity(size_t bytes) {
+        dictionary.setCacheCapacity(bytes);
+        chunks.setCacheCapacity(bytes);
+    }
+
+private:
+    // The entry of a key in the dictionary.
+    struct PostingList {
+        int count;
+        int head;  // the index of the first chunk, or the only id if count is 1
+        int tail;  // the index of the last chunk, where new ids usually go
+    };
+    struct ChunkHeader {
+        int next;  // the index of the next chunk, or 0
+        int count;
+        int first_id;
+        int last_id;
+        int size;  // the number of bytes used in data
+    };
+    static constexpr int CHUNK_SIZE = 64;
+    // Greater than all ids, marking the end of a list.
+    static constexpr int NO_ID = std::numeric_limits<int>::max();
+    struct Chunk {
+        ChunkHeader header;
+        // The gaps between the ids after first_id.
+        uint8_t data[CHUNK_SIZE - sizeof(ChunkHeader)];
+    };
+
+    HashIndex<Key, PostingList, Storage> dictionary;
+    MemoryRiver<Chunk, 0, Storage> chunks;
+
+    // Iterates over a list in ascending order, decoding one chunk at a time.
+    class Cursor {
+    public:
+        // An empty list is represented by a count of 0.
+        Cursor(InvertedIndex& index, const PostingList& list);
+        bool done() const { return pos == ids.size(); }
+        int value() const { return ids[pos]; }
+        void advance();
+        // Moves to the first id not less than target. Must not move backwards.
+        void seek(int target);
+
+    private:
+        InvertedIndex* index;
+        std::vector<int> ids;  // the ids of the current chunk
+        size_t pos = 0;
+        int next = 0;
+        void load(int chunk);
+    };
+
+    // Returns the list of key, or an empty one with count 0.
+    PostingList find(const Key& key) { return dictionary.find(key).value_or(PostingList{}); }
+    static int varintSize(unsigned value);
+    // Encodes ids into chunk. Returns false if they don't fit.
+    static bool encode(std::span<const int> ids, int next, Chunk& chunk);
+    static std::vector<int> decode(const Chunk& chunk);
+    // Writes ids followed by next into the chunk at index, or into a new chunk if index is 0.
+    // The ids are split into more chunks if they don't fit. Returns the index of the first chunk.
+    int store(std::span<const int> ids, int index, int next);
+    // Keeps the ids that are in the list of at least one of keys if keep_matches is true, or the
+    // ids that are in none of them otherwise.
+    void filter(std::vector<int>& ids, const std::vector<Key>& keys, bool keep_matches);
+};
+
+template <class Key, class Storage>
+InvertedIndex<Key, Storage>::Cursor::Cursor(InvertedIndex& index, const PostingList& list)
+    : index(&index) {
+    if (list.count == 1) {
+        ids.push_back(list.head);
+    } else if (list.count > 1) {
+        load(list.head);
+    }
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::Cursor::load(int chunk) {
+    Chunk data;
+    index->chunks.read(data, chunk);
+    ids = decode(data);
+    pos = 0;
+    next = data.header.next;
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::Cursor::advance() {
+    if (++pos == ids.size() && next) load(next);
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::Cursor::seek(int target) {
+    if (done() || ids.back() < target) {
+        // skip the chunks ending before target by their headers
+        while (next) {
+            ChunkHeader header;
+            index->chunks.read(header, next, 0);
+            if (header.last_id >= target) break;
+            next = header.next;
+        }
+        if (!next) {
+            pos = ids.size();
+            return;
+        }
+        load(next);
+    }
+    pos = std::lower_bound(ids.begin() + pos, ids.end(), target) - ids.begin();
+}
+
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::initialise(const std::string& file_name) {
+    dictionary.initialise(file_name);
+    chunks.initialise(file_name + "_postings");
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::insert(const Key& key, int id) {
+    const PostingList list = find(key);
+    if (list.count == 0) {
+        dictionary.insert(key, {1, id, 0});
+        return;
+    }
+    if (list.count == 1) {
+        if (list.head == id) return;
+        const int ids[2] = {std::min(list.head, id), std::max(list.head, id)};
+        const int index = store(ids, 0, 0);
+        dictionary.update(key, {2, index, index});
+        return;
+    }
+    // id goes into the first chunk whose last id is not less than it, or the last chunk
+    ChunkHeader header;
+    chunks.read(header, list.tail, 0);
+    int index = list.tail;
+    if (header.first_id > id) {
+        for (index = list.head;; index = header.next) {
+            chunks.read(header, index, 0);
+            if (header.last_id >= id) break;
+        }
+    }
+    Chunk chunk;
+    chunks.read(chunk, index);
+    std::vector<int> ids = decode(chunk);
+    const auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it != ids.end() && *it == id) return;
+    ids.insert(it, id);
+    store(ids, index, chunk.header.next);
+    PostingList updated{list.count + 1, list.head, list.tail};
+    if (index == list.tail) {
+        // the last chunk may have been split
+        chunks.read(header, index, 0);
+        while (header.next) {
+            index = header.next;
+            chunks.read(header, index, 0);
+        }
+        updated.tail = index;
+    }
+    dictionary.update(key, updated);
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::erase(const Key& key, int id) {
+    PostingList list = find(key);
+    if (list.count == 0) return;
+    if (list.count == 1) {
+        if (list.head == id) dictionary.erase(key);
+        return;
+    }
+    int prev = 0, index = list.head;
+    ChunkHeader header;
+    for (; index; prev = index, index = header.next) {
+        chunks.read(header, index, 0);
+        if (header.last_id >= id) break;
+    }
+    if (!index || header.first_id > id) return;
+    Chunk chunk;
+    chunks.read(chunk, index);
+    std::vector<int> ids = decode(chunk);
+    const auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id) return;
+    ids.erase(it);
+    if (ids.empty()) {
+        chunks.erase(index);
+        if (prev) {
+            chunks.update(header.next, prev, offsetof(ChunkHeader, next));
+        } else {
+            list.head = header.next;
+        }
+        if (index == list.tail) list.tail = prev;
+    } else {
+        store(ids, index, header.next);
+    }
+    if (--list.count == 1) {
+        // the only id left is moved into the dictionary
+        chunks.read(header, list.head, 0);
+        chunks.erase(list.head);
+        list.head = header.first_id;
+    }
+    dictionary.update(key, list);
+}
+template <class Key, class Storage>
+std::vector<int> InvertedIndex<Key, Storage>::query(const Key& key) {
+    const PostingList list = find(key);
+    if (list.count <= 1) return list.count ? std::vector<int>{list.head} : std::vector<int>{};
+    std::vector<int> result;
+    result.reserve(list.count);
+    for (int index = list.head; index;) {
+        Chunk chunk;
+        chunks.read(chunk, index);
+        const std::vector<int> ids = decode(chunk);
+        result.insert(result.end(), ids.begin(), ids.end());
+        index = chunk.header.next;
+    }
+    return result;
+}
+template <class Key, class Storage>
+std::vector<int> InvertedIndex<Key, Storage>::query(const std::vector<Key>& all_of,
+                                                    const std::vector<Key>& any_of,
+                                                    const std::vector<Key>& none_of) {
+    assert(!all_of.empty() || !any_of.empty());
+    std::vector<int> result;
+    if (all_of.empty()) {
+        for (const Key& key : any_of) {
+            const std::vector<int> ids = query(key);
+            std::vector<int> merged;
+            std::ranges::set_union(result, ids, std::back_inserter(merged));
+            result = std::move(merged);
+        }
+    } else {
+        std::vector<PostingList> lists;
+        for (const Key& key : all_of) {
+            lists.push_back(find(key));
+            if (lists.back().count == 0) return {};
+        }
+        // the shortest list proposes the candidates, and the others seek to them
+        std::ranges::sort(lists, {}, &PostingList::count);
+        std::vector<Cursor> cursors;
+        for (const PostingList& list : lists) cursors.emplace_back(*this, list);
+        Cursor& lead = cursors.front();
+        while (!lead.done()) {
+            const int candidate = lead.value();
+            int next_candidate = candidate;
+            for (size_t i = 1; i < cursors.size() && next_candidate == candidate; i++) {
+                cursors[i].seek(candidate);
+                next_candidate = cursors[i].done() ? NO_ID : cursors[i].value();
+            }
+            if (next_candidate == NO_ID) break;
+            if (next_candidate == candidate) {
+                result.push_back(candidate);
+                lead.advance();
+            } else {
+                lead.seek(next_candidate);
+            }
+        }
+        if (!any_of.empty()) filter(result, any_of, true);
+    }
+    filter(result, none_of, false);
+    return result;
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::filter(std::vector<int>& ids, const std::vector<Key>& keys,
+                                         bool keep_matches) {
+    if (ids.empty() || keys.empty()) return;
+    std::vector<Cursor> cursors;
+    for (const Key& key : keys) cursors.emplace_back(*this, find(key));
+    // the ids are ascending, so each cursor only moves forwards
+    size_t kept = 0;
+    for (const int id : ids) {
+        bool matches = false;
+        for (Cursor& cursor : cursors) {
+            cursor.seek(id);
+            if (!cursor.done() && cursor.value() == id) {
+                matches = true;
+                break;
+            }
+        }
+        if (matches == keep_matches) ids[kept++] = id;
+    }
+    ids.resize(kept);
+}
+template <class Key, class Storage>
+size_t InvertedIndex<Key, Storage>::count(const Key& key) {
+    return find(key).count;
+}
+template <class Key, class Storage>
+void InvertedIndex<Key, Storage>::bulkLoad(const std::vector<std::pair<Key, int>>& pairs) {
+    for (size_t begin = 0, end; begin < pairs.size(); begin = end) {
+        std::vector<int> ids;
+        for (end = begin; end < pairs.size() && pairs[end].first == pairs[begin].first; end++) {
+            ids.push_back(pairs[end].second);
+        }
+        if (ids.size() == 1) {
+            dictionary.insert(pairs[begin].first, {1, ids[0], 0});
+            continue;
+        }
+        // the chunks are written from the back, as each one links to the next
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t first = 0, last; first < ids.size(); first = last) {
+            int size = 0;
+            for (last = first + 1; last < ids.size(); last++) {
+                size += varintSize(ids[last] - ids[last - 1]);
+                if (size > sizeof(Chunk::data)) break;
+            }
+            ranges.emplace_back(first, last);
+        }
+        int next = 0, tail = 0;
+        for (auto it = ranges.rbegin(); it != ranges.rend(); ++it) {
+            next = store(std::span(ids).subspan(it->first, it->second - it->first), 0, next);
+            if (!tail) tail = next;
+        }
+        dictionary.insert(pairs[begin].first, {static_cast<int>(ids.size()), next, tail});
+    }
+}
+template <class Key, class Storage>
+int InvertedIndex<Key, Storage>::varintSize(unsigned value) {
+    int size = 1;
+    while (value >>= 7) size++;
+    return size;
+}
+template <class Key, class Storage>
+bool InvertedIndex<Key, Storage>::encode(std::span<const int> ids, int next, Chunk& chunk) {
+    chunk.header = {next, static_cast<int>(ids.size()), ids.front(), ids.back(), 0};
+    for (size_t i = 1; i < ids.size(); i++) {
+        unsigned gap = ids[i] - ids[i - 1];
+        do {
+            if (chunk.header.size == sizeof(chunk.data)) return false;
+            const uint8_t byte = gap & 0x7f;
+            gap >>= 7;
+            chunk.data[chunk.header.size++] = byte | (gap ? 0x80 : 0);
+        } while (gap);
+    }
+    return true;
+}
+template <class Key, class Storage>
+std::vector<int> InvertedIndex<Key, Storage>::decode(const Chunk& chunk) {
+    std::vector<int> ids{chunk.header.first_id};
+    ids.reserve(chunk.header.count);
+    for (int pos = 0; pos < chunk.header.size;) {
+        unsigned gap = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = chunk.data[pos++];
+            gap |= static_cast<unsigned>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        ids.push_back(ids.back() + gap);
+    }
+    return ids;
+}
+template <class Key, class Storage>
+int InvertedIndex<Key, Storage>::store(std::span<const int> ids, int index, int next) {
+    Chunk chunk{};
+    if (encode(ids, next, chunk)) {
+        if (index) {
+            chunks.update(chunk, index);
+        } else {
+            index = chunks.write(chunk);
+        }
+        return index;
+    }
+    const size_t mid = ids.size() / 2;
+    const int second = store(ids.subspan(mid), 0, next);
+    return store(ids.first(mid), index, second);
+}
+
+#endif  // BOOKSTORE_INVERTEDINDEX_HPP
@@ -1,25 +1,27 @@
 #ifndef BOOKSTORE_LOGMANAGER_HPP
 #define BOOKSTORE_LOGMANAGER_HPP
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ranges>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "BlockList.hpp"
 #include "MemoryRiver.hpp"
+#include "OperationLog.hpp"
 #include "UsersManager.hpp"
 
-namespace Log {
-using OPERATION_T = std::array<char, 300>;
-};
-
 struct FinanceLogEntry {
     long long timestamp;
     User::USERID_T userid;
     long long value;  // positive for income, negative for expense
 };
-struct OperationLogEntry {
-    long long timestamp;
-    User::USERID_T userid;
-    int user_privilege;
-    Log::OPERATION_T op;
-    int is_success;
+// The total income and expense of the first entries of the finance log.
+struct FinanceTotal {
+    long long income;
+    long long expense;
 };
 
 class LogManager {
@@ -27,26 +29,87 @@ public:
     static LogManager& getInstance();
     // positive for income, negative for expense
     void addFinanceLog(long long timestamp, User::USERID_T userid, long long value);
-    // count must be greater than zero
+    // Returns the income and expense of the last cnt entries, or of all entries if cnt is 0.
     std::pair<long long, long long> getFinanceValue(int cnt = 0);
+    // Recomputes the running totals of the finance log from the first entry not covered.
+    void rebuildFinanceTotals();
 
     int addOperationLog(long long timestamp, User::USERID_T userid, int privilege,
-                        Log::OPERATION_T op);
+                        Log::Operation op);
     void markOperationSuccess(int id);
+    // Enables or disables the asynchronous operation log. When enabled, addOperationLog only puts
+    // the entry into an in-memory buffer, and a background thread writes the entries in batches.
+    // Buffered entries are lost if the process is killed. Disabling writes all buffered entries.
+    void setAsyncOperationLog(bool enabled);
+    // Blocks until all operation log entries added so far are written. The getters of the
+    // operation log call it themselves.
+    void flushOperationLog();
 
     int getFinanceLogCount();
     FinanceLogEntry getFinanceLogEntry(int id);
     int getOperationLogCount();
     OperationLogEntry getOperationLogEntry(int id);
 
-    std::vector<std::pair<User::USERID_T, int>> getUserIdPairs();
+    // Calls func(entry) for the operation log entries of all users except guests, in the order of
+    // (userid, id). The entries are read one at a time, and func must not call the LogManager.
+    template <class Func>
+    void forEachOperationLogByUser(Func&& func);
 
 private:
     LogManager();
-    ~LogManager() = default;
+    ~LogManager();
+    // Stores finance_total as the running total of the first i finance log entries, appending its
+    // slot if it has not been allocated yet. Requires finance_mutex.
+    void putFinanceTotal(int i);
+    // Memory budget of the page cache of each log file.
+    static constexpr size_t CACHE_SIZE = 1 << 20;
+    // The number of entries that the asynchronous operation log can buffer.
+    static constexpr int LOG_BUFFER_SIZE = 1024;
+    // How long the writer waits to gather a batch, so that most entries are marked successful
+    // before they are written.
+    static constexpr auto GROUP_COMMIT_DELAY = std::chrono::milliseconds(2);
+
+    // Guards finance_log, finance_totals and finance_total, so that an entry and its running total
+    // are appended together.
+    std::mutex finance_mutex;
     MemoryRiver<FinanceLogEntry, 1> finance_log;
-    MemoryRiver<OperationLogEntry, 1> operation_log;
-    BlockList<User::USERID_T, int> user_index;
+    // The entry at index i is the running total of the first i finance log entries. The entries
+    // are appended by write, and the only info stores the number of them that are valid.
+    MemoryRiver<FinanceTotal, 1> finance_totals;
+    // The total of all finance log entries.
+    FinanceTotal finance_total{};
+    OperationLogFile operation_log;
+    BlockList<User::USERID_T, int, MappedFile> user_index;
+
+    // Guards the fields of the asynchronous operation log below. Without the background writer, it
+    // is held while an entry is written.
+    std::mutex buffer_mutex;
+    std::condition_variable buffer_cv;
+    // Guards operation_log and user_index.
+    std::mutex io_mutex;
+    // The entry with id is buffered at log_buffer[id % LOG_BUFFER_SIZE] until it is taken.
+    std::vector<OperationLogEntry> log_buffer;
+    // The number of entries added, taken by the writer, and written to file.
+    int log_count = 0;
+    int taken_count = 0;
+    int written_count = 0;
+    int flush_waiters = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    // The loop of the background writer.
+    void runOperationLogWriter();
+    // Writes n entries with consecutive ids from first_id to file.
+    void writeOperationLogs(const OperationLogEntry* entries, int first_id, int n);
 };
 
+template <class Func>
+void LogManager::forEachOperationLogByUser(Func&& func) {
+    flushOperationLog();
+    std::lock_guard io_lock(io_mutex);
+    for (const auto& [userid, id] : std::ranges::subrange(user_index.begin(), user_index.end())) {
+        func(operation_log.read(id));
+    }
+}
+
 #endif  // BOOKSTORE_LOGMANAGER_HPP
@@ -0,0 +1,78 @@
+#ifndef BOOKSTORE_MAPPEDFILE_HPP
+#define BOOKSTORE_MAPPEDFILE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "PagedFile.hpp"
+#include "SharedMutex.hpp"
+#include "WriteAheadLog.hpp"
+
+#ifdef _WIN32
+// Memory mapping is only implemented for POSIX systems; fall back to the paged backend.
+using MappedFile = PagedFile;
+#else
+// A binary file addressed by byte offsets, served from a shared memory mapping.
+//
+// It has the same interface as PagedFile, so it can be used as the storage backend of MemoryRiver.
+// Reads and writes are plain memory copies; the file is grown in chunks of GROW_CHUNK bytes and
+// remapped, and is truncated back to its real size on close().
+//
+// Reads and writes may be called from several threads at once. They share remap_mutex, which is
+// only held exclusively while the mapping is grown and may move. Like PagedFile, a file opened
+// while the WriteAheadLog is open is accessed through the log.
+class MappedFile {
+public:
+    static constexpr long long GROW_CHUNK = 1 << 20;
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Opens file_name for reading and writing. Creates an empty file if it doesn't exist.
+    void open(const std::string& file_name);
+    // Unmaps and closes the file.
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // Reads len bytes at pos into dst. Bytes beyond the end of file are read as zeroes.
+    void read(char* dst, long long pos, size_t len);
+    // Writes len bytes from src to pos. The file is extended if necessary.
+    void write(const char* src, long long pos, size_t len);
+    // Schedules the modified pages to be written back to the file.
+    void flush();
+    // Writes the modified pages back to the file, and waits until the file is durable.
+    void sync();
+    long long size() const {
+        return wal ? std::max(file_size.load(), wal->size()) : file_size.load();
+    }
+
+    // The kernel page cache is used directly, these only exist for parity with PagedFile.
+    void setCacheCapacity(size_t) {}
+    size_t getCacheHits() const { return 0; }
+    size_t getCacheMisses() const { return 0; }
+
+private:
+    int fd = -1;
+    char* base = nullptr;
+    // The size of the data written, and the size of the mapping (and of the file on disk).
+    std::atomic<long long> file_size = 0;
+    long long mapped_size = 0;
+    // Guards base and mapped_size.
+    SharedMutex remap_mutex;
+    // The writes not committed yet, if the file is logged.
+    std::unique_ptr<WriteAheadLog::FileLog> wal;
+
+    // read() and write() bypassing the log.
+    void readDirect(char* dst, long long pos, size_t len);
+    void writeDirect(const char* src, long long pos, size_t len);
+    // Grows the file and the mapping to hold at least size bytes.
+    void reserve(long long size);
+};
+#endif
+
+#endif  // BOOKSTORE_MAPPEDFILE_HPP
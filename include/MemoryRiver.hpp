@@ -1,16 +1,27 @@
 #ifndef BPT_MEMORYRIVER_HPP
 #define BPT_MEMORYRIVER_HPP
 
+#include <atomic>
 #include <cassert>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "PagedFile.hpp"
 
 // A persistent container that stores a POD object, and support storing some extra int info.
 //
 // Template Args:
 //  T: The type of the object to be stored. Must be POD.
 //  info_len: the extra info (of type int) that can be stored in MemoryRiver. Default set to 2.
-template <class T, int info_len = 2>
+//  Storage: the file backend, either PagedFile (pread/pwrite with an optional page cache) or
+//           MappedFile (memory mapped). Default set to PagedFile.
+//
+// Objects may be read, written and erased from several threads at once, as long as no two threads
+// access the same object while one of them modifies it.
+template <class T, int info_len = 2, class Storage = PagedFile>
 class MemoryRiver {
     static_assert(std::is_trivially_copyable_v<T>, "T must be POD");
     static_assert(sizeof(T) >= sizeof(int), "The sizeof T must be greater than size of int");
@@ -26,6 +37,9 @@ public:
     void getInfo(int& tmp, int n);
     // Writes tmp into the n-th info (1-based).
     void writeInfo(int tmp, int n);
+    // Returns the n-th info (1-based) of the file file_name without opening it as a MemoryRiver, or
+    // 0 if the file is too short. An info can thus mark the format of a file.
+    static int peekInfo(const std::string& file_name, int n);
 
     // Writes t in to file. Returns an index for future operations.
     // The index retyrurned will always be a positive integer.
@@ -40,22 +54,51 @@ public:
     // Partially reads the object at index. The index is that generated by write before.
     template <class U>
     void read(U& u, int index, size_t offset);
+    // Updates the n consecutive objects from index with the objects at t, in a single write.
+    void updateRange(const T* t, int index, int n);
+    // Partially updates the object at index with the n objects at u.
+    template <class U>
+    void update(const U* u, int index, size_t offset, size_t n);
+    // Partially reads n objects of type U at offset of the object at index into u.
+    template <class U>
+    void read(U* u, int index, size_t offset, size_t n);
     // Deletes the object at index.
     void erase(int index);
+    // Returns the number of slots ever allocated by write, which is the largest index it returned.
+    // A MemoryRiver that is only appended to can use it as its length.
+    int getCount() const { return count; }
+
+    // Sets the memory budget of the page cache in bytes. Zero (the default) disables the cache.
+    // Has no effect on MappedFile.
+    void setCacheCapacity(size_t bytes) { file.setCacheCapacity(bytes); }
+    // Writes all cached modifications back to the file.
+    void flush();
+    size_t getCacheHits() const { return file.getCacheHits(); }
+    size_t getCacheMisses() const { return file.getCacheMisses(); }
 
 private:
-    int count = 0;
+    // The number of slots ever allocated, and the head of the list of erased slots.
+    std::atomic<int> count = 0;
     int free_head = 0;
-    std::fstream file;
+    // Guards free_head and the free list, so that a slot is handed out only once.
+    std::mutex free_mutex;
+    Storage file;
     std::string file_name;
 
     static constexpr int SUPER_INFO_LEN = 2;
     static constexpr int GLOBAL_OFFSET = SUPER_INFO_LEN * sizeof(int);
     static constexpr int SIZEOF_T = sizeof(T);
+    static constexpr int SIZEOF_INT = sizeof(int);
 
-    // Initializes a new file.
+    // Returns the position of the object at index in file.
+    static long long position(int index) {
+        return GLOBAL_OFFSET + info_len * sizeof(int) +
+               static_cast<long long>(SIZEOF_T) * (index - 1);
+    }
+
+    // Writes the zeroed info of a new file.
     void initFile();
-    // Opens the existing file.
+    // Loads the super info from the opened file.
     void openFile();
     // Returns the next pointer for the free list.
     int getNext(int index);
@@ -63,104 +106,143 @@ private:
     void writeNext(int index, int val);
 };
 
-template <class T, int info_len>
-MemoryRiver<T, info_len>::~MemoryRiver() {
+template <class T, int info_len, class Storage>
+MemoryRiver<T, info_len, Storage>::~MemoryRiver() {
     writeInfo(count, -1);
     writeInfo(free_head, 0);
     file.close();
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::initialise(const std::string& _file_name) {
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::initialise(const std::string& _file_name) {
     if (!_file_name.empty()) file_name = _file_name;
-    if (!std::filesystem::exists(file_name)) {
+    const bool is_new = !std::filesystem::exists(file_name);
+    file.open(file_name);
+    if (is_new) {
         initFile();
     }
     openFile();
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::getInfo(int& tmp, int n) {
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::getInfo(int& tmp, int n) {
     if (n > info_len) return;
-    assert(file.is_open());
-    file.seekg(GLOBAL_OFFSET + (n - 1) * sizeof(int));
-    file.read(reinterpret_cast<char*>(&tmp), sizeof(int));
+    assert(file.isOpen());
+    file.read(reinterpret_cast<char*>(&tmp), GLOBAL_OFFSET + (n - 1) * SIZEOF_INT, sizeof(int));
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::writeInfo(int tmp, int n) {
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::writeInfo(int tmp, int n) {
     if (n > info_len) return;
-    assert(file.is_open());
-    file.seekp(GLOBAL_OFFSET + (n - 1) * sizeof(int));
-    file.write(reinterpret_cast<const char*>(&tmp), sizeof(int));
-}
-template <class T, int info_len>
-int MemoryRiver<T, info_len>::write(const T& t) {
-    assert(file.is_open());
-    if (!free_head) {
-        file.seekp(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * count);
-        file.write(reinterpret_cast<const char*>(&t), SIZEOF_T);
-        return ++count;
+    assert(file.isOpen());
+    file.write(reinterpret_cast<const char*>(&tmp), GLOBAL_OFFSET + (n - 1) * SIZEOF_INT,
+               sizeof(int));
+}
+template <class T, int info_len, class Storage>
+int MemoryRiver<T, info_len, Storage>::peekInfo(const std::string& file_name, int n) {
+    assert(1 <= n && n <= info_len);
+    int tmp = 0;
+    std::ifstream in(file_name, std::ios::binary);
+    in.seekg(GLOBAL_OFFSET + (n - 1) * SIZEOF_INT);
+    in.read(reinterpret_cast<char*>(&tmp), sizeof(int));
+    return in ? tmp : 0;
+}
+template <class T, int info_len, class Storage>
+int MemoryRiver<T, info_len, Storage>::write(const T& t) {
+    assert(file.isOpen());
+    int pos;
+    {
+        std::lock_guard lock(free_mutex);
+        // the super info is written as soon as it changes, so that a file replayed from the
+        // WriteAheadLog after a crash is consistent
+        if (free_head) {
+            pos = free_head;
+            free_head = getNext(free_head);
+            writeInfo(free_head, 0);
+        } else {
+            pos = ++count;
+            writeInfo(count, -1);
+        }
     }
-    const int pos = free_head;
-    free_head = getNext(free_head);
-    file.seekp(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (pos - 1));
-    file.write(reinterpret_cast<const char*>(&t), SIZEOF_T);
+    file.write(reinterpret_cast<const char*>(&t), position(pos), SIZEOF_T);
     return pos;
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::update(const T& t, const int index) {
-    assert(file.is_open());
-    file.seekp(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (index - 1));
-    file.write(reinterpret_cast<const char*>(&t), SIZEOF_T);
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::update(const T& t, const int index) {
+    assert(file.isOpen());
+    file.write(reinterpret_cast<const char*>(&t), position(index), SIZEOF_T);
 }
-template <class T, int info_len>
+template <class T, int info_len, class Storage>
 template <class U>
-void MemoryRiver<T, info_len>::update(const U& u, const int index, const size_t offset) {
-    file.seekp(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (index - 1) + offset);
-    file.write(reinterpret_cast<const char*>(&u), sizeof(U));
+void MemoryRiver<T, info_len, Storage>::update(const U& u, const int index, const size_t offset) {
+    file.write(reinterpret_cast<const char*>(&u), position(index) + offset, sizeof(U));
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::read(T& t, const int index) {
-    assert(file.is_open());
-    file.seekg(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (index - 1));
-    file.read(reinterpret_cast<char*>(&t), SIZEOF_T);
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::read(T& t, const int index) {
+    assert(file.isOpen());
+    file.read(reinterpret_cast<char*>(&t), position(index), SIZEOF_T);
 }
-template <class T, int info_len>
+template <class T, int info_len, class Storage>
 template <class U>
-void MemoryRiver<T, info_len>::read(U& u, const int index, const size_t offset) {
-    file.seekg(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (index - 1) + offset);
-    file.read(reinterpret_cast<char*>(&u), sizeof(U));
+void MemoryRiver<T, info_len, Storage>::read(U& u, const int index, const size_t offset) {
+    file.read(reinterpret_cast<char*>(&u), position(index) + offset, sizeof(U));
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::erase(const int index) {
-    assert(file.is_open());
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::updateRange(const T* t, const int index, const int n) {
+    assert(file.isOpen());
+    file.write(reinterpret_cast<const char*>(t), position(index),
+               static_cast<size_t>(SIZEOF_T) * n);
+}
+template <class T, int info_len, class Storage>
+template <class U>
+void MemoryRiver<T, info_len, Storage>::update(const U* u, const int index, const size_t offset,
+                                               const size_t n) {
+    assert(offset + n * sizeof(U) <= SIZEOF_T);
+    file.write(reinterpret_cast<const char*>(u), position(index) + offset, n * sizeof(U));
+}
+template <class T, int info_len, class Storage>
+template <class U>
+void MemoryRiver<T, info_len, Storage>::read(U* u, const int index, const size_t offset,
+                                             const size_t n) {
+    assert(offset + n * sizeof(U) <= SIZEOF_T);
+    file.read(reinterpret_cast<char*>(u), position(index) + offset, n * sizeof(U));
+}
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::erase(const int index) {
+    assert(file.isOpen());
+    std::lock_guard lock(free_mutex);
     writeNext(index, free_head);
     free_head = index;
+    writeInfo(free_head, 0);
+}
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::flush() {
+    {
+        std::lock_guard lock(free_mutex);
+        writeInfo(count, -1);
+        writeInfo(free_head, 0);
+    }
+    file.flush();
 }
 
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::initFile() {
-    file.open(file_name, std::ios::out | std::ios::binary);
-    int tmp = 0;
-    for (int i = 0; i < info_len + SUPER_INFO_LEN; ++i)
-        file.write(reinterpret_cast<char*>(&tmp), sizeof(int));
-    file.close();
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::initFile() {
+    const std::vector<int> zeros(info_len + SUPER_INFO_LEN);
+    file.write(reinterpret_cast<const char*>(zeros.data()), 0, zeros.size() * sizeof(int));
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::openFile() {
-    file.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
-    getInfo(count, -1);
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::openFile() {
+    int tmp;
+    getInfo(tmp, -1);
+    count = tmp;
     getInfo(free_head, 0);
 }
-template <class T, int info_len>
-int MemoryRiver<T, info_len>::getNext(int index) {
+template <class T, int info_len, class Storage>
+int MemoryRiver<T, info_len, Storage>::getNext(int index) {
     int nxt;
-    file.seekg(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (index - 1));
-    file.read(reinterpret_cast<char*>(&nxt), sizeof(int));
+    file.read(reinterpret_cast<char*>(&nxt), position(index), sizeof(int));
     return nxt;
 }
-template <class T, int info_len>
-void MemoryRiver<T, info_len>::writeNext(int index, int val) {
-    file.seekp(GLOBAL_OFFSET + (info_len) * sizeof(int) + SIZEOF_T * (index - 1));
-    file.write(reinterpret_cast<const char*>(&val), sizeof(int));
+template <class T, int info_len, class Storage>
+void MemoryRiver<T, info_len, Storage>::writeNext(int index, int val) {
+    file.write(reinterpret_cast<const char*>(&val), position(index), sizeof(int));
 }
 
 #endif  // BPT_MEMORYRIVER_HPP
\ No newline at end of file
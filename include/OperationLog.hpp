@@ -0,0 +1,133 @@
+#ifndef BOOKSTORE_OPERATIONLOG_HPP
+#define BOOKSTORE_OPERATIONLOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MemoryRiver.hpp"
+#include "PagedFile.hpp"
+#include "UsersManager.hpp"
+
+namespace Log {
+// The command of an operation.
+enum class OpCode : uint8_t {
+    LEGACY,  // an entry converted from the old format, holding the command text in a TEXT field
+    SU,
+    LOGOUT,
+    REGISTER,
+    PASSWD,
+    USERADD,
+    DELETE,
+    SHOW,
+    BUY,
+    SELECT,
+    MODIFY,
+    IMPORT,
+    SHOW_FINANCE,
+    REPORT_FINANCE,
+    REPORT_EMPLOYEE,
+    LOG,
+};
+// The argument of an operation.
+enum class Field : uint8_t {
+    TEXT,
+    USERID,
+    PASSWORD,
+    USERNAME,
+    PRIVILEGE,
+    ISBN,
+    NAME,
+    AUTHOR,
+    KEYWORD,
+    PRICE,
+    QUANTITY,
+    TOTAL_COST,
+    COUNT,
+    ANY_KEYWORD,
+    EXCLUDED_KEYWORD,
+    NAME_CONTAINS,
+    AUTHOR_CONTAINS,
+    MIN_PRICE,
+    MAX_PRICE,
+    MIN_QUANTITY,
+    MAX_QUANTITY,
+    CURSOR,
+    LIMIT,
+};
+
+// An operation in binary form: the opcode byte, followed by the arguments. Each argument is the
+// field byte, the length byte and the value; integers are stored as zigzag varints.
+class Operation {
+public:
+    Operation() = default;
+    explicit Operation(OpCode code);
+    // Appends an argument.
+    Operation& add(Field field, const std::string& value);
+    Operation& add(Field field, long long value);
+    // Returns the operation in the form of the command, e.g. "buy -ISBN=978 -quantity=1".
+    std::string toString() const;
+    // Gets or sets the binary form.
+    const std::string& data() const { return bytes; }
+    static Operation fromData(std::string data);
+
+private:
+    std::string bytes;
+};
+}  // namespace Log
+
+struct OperationLogEntry {
+    long long timestamp;
+    User::USERID_T userid;
+    int user_privilege;
+    Log::Operation op;
+    int is_success;
+};
+
+// The operation log, stored as variable-length records addressed by 1-based ids.
+//
+// A record is the 2-byte length of the record, the success flag, the privilege, the timestamp, the
+// length-prefixed userid and the binary operation. The offset of every INDEX_STRIDE-th record is
+// kept in a sparse index, so a record is found by seeking to the nearest indexed record before it
+// and skipping the records in between. Reading the records in order only skips from the last one.
+class OperationLogFile {
+public:
+    // Opens the log and its index. Creates new files if they don't exist.
+    void open(const std::string& file_name, const std::string& index_file_name);
+    // Returns the number of records.
+    int size() const { return count; }
+    // Appends n entries, which get the ids from size() + 1.
+    void append(const OperationLogEntry* entries, int n);
+    // Reads the entry with id. Prerequisite: 1 <= id <= size().
+    OperationLogEntry read(int id);
+    // Marks the entry with id as successful with a 1-byte write.
+    void markSuccess(int id);
+    void setCacheCapacity(size_t bytes) { file.setCacheCapacity(bytes); }
+
+private:
+    static constexpr int INDEX_STRIDE = 64;
+    static constexpr int SUCCESS_OFFSET = 2;
+    static constexpr int PRIVILEGE_OFFSET = 3;
+    static constexpr int TIMESTAMP_OFFSET = 4;
+    static constexpr int USERID_OFFSET = 12;
+
+    PagedFile file;
+    // The index at k stores the offset of the record with id (k - 1) * INDEX_STRIDE + 1. The
+    // entries are appended by write. The only info stores the number of records.
+    MemoryRiver<long long, 1> index;
+    int count = 0;
+    long long end_offset = 0;
+    // The last record located.
+    int cursor_id = 0;
+    long long cursor_offset = 0;
+
+    // Returns the offset of the record with id. Prerequisite: 1 <= id <= size() + 1.
+    long long locate(int id);
+    // Stores the offset of the record with id in the index, appending its entry if it has not been
+    // allocated yet. Prerequisite: (id - 1) % INDEX_STRIDE == 0.
+    void putOffset(int id, long long offset);
+    // Returns the length of the record at offset.
+    int recordLength(long long offset);
+};
+
+#endif  // BOOKSTORE_OPERATIONLOG_HPP
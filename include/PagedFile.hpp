@@ -0,0 +1,99 @@
+#ifndef BOOKSTORE_PAGEDFILE_HPP
+#define BOOKSTORE_PAGEDFILE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "WriteAheadLog.hpp"
+
+// A binary file addressed by byte offsets, with an optional in-process page cache.
+//
+// When the cache is enabled, the file is accessed in pages of PAGE_SIZE bytes. Pages are kept in
+// memory in LRU order and evicted once the memory budget is exceeded. Modified pages are only
+// written back on eviction, on flush() or on close().
+//
+// The file is accessed with positional I/O, so reads and writes may be called from several threads
+// at once; the page cache is guarded by a mutex. Writes to overlapping ranges are not ordered.
+//
+// A file opened while the WriteAheadLog is open is accessed through the log, which writes to the
+// file only once the writes are committed.
+class PagedFile {
+public:
+    static constexpr int PAGE_SIZE = 4096;
+
+    PagedFile() = default;
+    ~PagedFile();
+    PagedFile(const PagedFile&) = delete;
+    PagedFile& operator=(const PagedFile&) = delete;
+
+    // Opens file_name for reading and writing. Creates an empty file if it doesn't exist.
+    void open(const std::string& file_name);
+    // Writes back all dirty pages and closes the file.
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // Reads len bytes at pos into dst. Bytes beyond the end of file are read as zeroes.
+    void read(char* dst, long long pos, size_t len);
+    // Writes len bytes from src to pos. The file is extended if necessary.
+    void write(const char* src, long long pos, size_t len);
+    // Writes all dirty pages back to the file.
+    void flush();
+    // Writes all dirty pages back to the file, and waits until the file is durable.
+    void sync();
+    // Truncates the file to size bytes.
+    void truncate(long long size);
+    // Returns the size of the file, including data not yet written back.
+    long long size() const {
+        return wal ? std::max(file_size.load(), wal->size()) : file_size.load();
+    }
+
+    // Sets the memory budget of the page cache in bytes. Zero (the default) disables the cache.
+    void setCacheCapacity(size_t bytes);
+    size_t getCacheHits() const { return hits; }
+    size_t getCacheMisses() const { return misses; }
+
+private:
+    struct Page {
+        long long page_no;
+        bool dirty;
+        std::vector<char> data;
+    };
+
+    int fd = -1;
+    std::atomic<long long> file_size = 0;
+    // The writes not committed yet, if the file is logged.
+    std::unique_ptr<WriteAheadLog::FileLog> wal;
+
+    // The maximum number of pages kept in memory. Zero means the cache is disabled.
+    size_t max_pages = 0;
+    // Guards the cache below. The file itself needs no lock.
+    std::mutex cache_mutex;
+    // Cached pages, the most recently used one at the front.
+    std::list<Page> lru;
+    std::unordered_map<long long, std::list<Page>::iterator> page_table;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    // Returns the cached page page_no, loading it from file on a miss.
+    // If overwrite is true, the caller will overwrite the whole page, so it is not loaded.
+    Page& fetchPage(long long page_no, bool overwrite);
+    // read() and write() bypassing the log.
+    void readDirect(char* dst, long long pos, size_t len);
+    void writeDirect(const char* src, long long pos, size_t len);
+    // Evicts pages until at most max_pages - reserve pages remain.
+    void evict(size_t reserve);
+    void writeBack(Page& page);
+    void readFromFile(char* dst, long long pos, size_t len);
+    void writeToFile(const char* src, long long pos, size_t len);
+    // Raises file_size to at least end.
+    void extendTo(long long end);
+};
+
+#endif  // BOOKSTORE_PAGEDFILE_HPP
@@ -12,6 +12,8 @@ Book::BOOKNAME_T parseBookName(const std::string& token);
 Book::AUTHOR_T parseAuthor(const std::string& token);
 Book::KEYWORD_T parseKeyword(const std::string& token);
 int parseQuantity(const std::string& token);
+// Parses a bound of a range of quantities, which may be zero.
+int parseStockLevel(const std::string& token);
 long long parsePrice(const std::string& token);
 int parseCount(const std::string& token);
 User::USERID_T parse_userid(const std::string& token);
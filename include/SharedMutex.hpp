@@ -0,0 +1,31 @@
+#ifndef BOOKSTORE_SHAREDMUTEX_HPP
+#define BOOKSTORE_SHAREDMUTEX_HPP
+
+#include <mutex>
+#include <shared_mutex>
+
+// A reader-writer lock that doesn't starve writers. It can be used with std::unique_lock and
+// std::shared_lock.
+//
+// std::shared_mutex prefers readers on glibc, so a writer can wait forever while readers keep
+// overlapping. Here both pass through gate: a waiting writer holds it, so the readers that come
+// after the writer wait for it.
+class SharedMutex {
+public:
+    void lock() {
+        std::lock_guard gate_lock(gate);
+        mutex.lock();
+    }
+    void unlock() { mutex.unlock(); }
+    void lock_shared() {
+        std::lock_guard gate_lock(gate);
+        mutex.lock_shared();
+    }
+    void unlock_shared() { mutex.unlock_shared(); }
+
+private:
+    std::mutex gate;
+    std::shared_mutex mutex;
+};
+
+#endif  // BOOKSTORE_SHAREDMUTEX_HPP
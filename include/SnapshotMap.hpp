@@ -0,0 +1,215 @@
+#ifndef BOOKSTORE_SNAPSHOTMAP_HPP
+#define BOOKSTORE_SNAPSHOTMAP_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation of the objects read by lock-free readers.
+//
+// A reader pins the current epoch while it reads. A writer retires the objects it replaced, and
+// ends the epoch with advance(). A retired object is freed once every reader that could have seen
+// it is gone. Writers must be serialized by the caller.
+class EpochReclaimer {
+public:
+    // The number of readers that can be pinned at once. More readers wait for a free slot.
+    static constexpr size_t MAX_READERS = 64;
+
+    // Keeps an epoch pinned while it is alive.
+    class Guard {
+    public:
+        ~Guard() { slot.store(0); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        friend class EpochReclaimer;
+        explicit Guard(std::atomic<uint64_t>& _slot) : slot(_slot) {}
+        std::atomic<uint64_t>& slot;
+    };
+
+    EpochReclaimer() = default;
+    // Frees all retired objects. No reader may be pinned.
+    ~EpochReclaimer();
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // Pins the current epoch until the guard is destroyed.
+    Guard pin();
+    // Calls free once no reader can see the object any more.
+    void retire(std::function<void()> free);
+    // Ends the current epoch, and frees the retired objects no pinned reader can see.
+    void advance();
+    uint64_t getEpoch() const { return epoch; }
+    // Returns the number of retired objects not freed yet.
+    size_t getPending() const { return retired.size(); }
+
+private:
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> free;
+    };
+
+    std::atomic<uint64_t> epoch = 1;
+    // The epoch pinned by each reader, or 0 for a free slot.
+    std::array<std::atomic<uint64_t>, MAX_READERS> slots{};
+    // In the order of the epochs they were retired in.
+    std::deque<Retired> retired;
+};
+
+// A hash map from keys to the latest immutable versions of objects, which is read without locks.
+//
+// The key of an object is its member key_member. A writer replaces the version of an object with
+// a new one instead of modifying it, so readers always see a whole version, and the replaced
+// versions are freed by epochs. Writers must be serialized by the caller.
+template <class T, auto key_member>
+class SnapshotMap {
+public:
+    typedef std::remove_cvref_t<decltype(std::declval<T>().*key_member)> Key;
+    static_assert(std::has_unique_object_representations_v<Key>, "Key is hashed by its bytes");
+
+    SnapshotMap() : table(new Table(MIN_CAPACITY)) {}
+    // No reader may be running.
+    ~SnapshotMap();
+    SnapshotMap(const SnapshotMap&) = delete;
+    SnapshotMap& operator=(const SnapshotMap&) = delete;
+
+    // Returns a copy of the latest version with key. Never blocks on writers.
+    std::optional<T> find(const Key& key);
+    // Publishes value as the latest version of its key.
+    void put(const T& value);
+    // Removes the object with key, if any.
+    void erase(const Key& key);
+    // Returns the number of objects. Like the modifications, it must not race with writers.
+    size_t size() const { return table.load()->size; }
+    // Returns the number of replaced versions that readers may still see.
+    size_t getPending() const { return reclaimer.getPending(); }
+
+private:
+    static constexpr size_t MIN_CAPACITY = 64;
+
+    struct Table {
+        explicit Table(size_t capacity) : slots(capacity) {}
+        // Open addressing with linear probing; the capacity is a power of 2. Erased slots hold
+        // tombstone() so that the probes through them go on.
+        std::vector<std::atomic<const T*>> slots;
+        // The slots in use, including the tombstones, which are at most half of the slots.
+        size_t used = 0;
+        size_t size = 0;
+    };
+    std::atomic<Table*> table;
+    EpochReclaimer reclaimer;
+
+    static const T* tombstone() {
+        static const T value{};
+        return &value;
+    }
+    static uint64_t hash(const Key& key);
+    // Returns the slot of key in t, or the empty slot ending its probe sequence.
+    static size_t probe(const Table& t, const Key& key);
+    // Stores version in the slot of key in t, which must be a new key.
+    static void insert(Table& t, const T* version);
+    // Moves the versions into a table with room for as many more. The old table is retired.
+    void rehash();
+};
+
+template <class T, auto key_member>
+SnapshotMap<T, key_member>::~SnapshotMap() {
+    Table* t = table.load();
+    for (auto& slot : t->slots) {
+        const T* version = slot.load();
+        if (version && version != tombstone()) delete version;
+    }
+    delete t;
+}
+template <class T, auto key_member>
+std::optional<T> SnapshotMap<T, key_member>::find(const Key& key) {
+    const auto guard = reclaimer.pin();
+    const Table& t = *table.load();
+    const T* version = t.slots[probe(t, key)].load();
+    if (!version) return std::nullopt;
+    return *version;
+}
+template <class T, auto key_member>
+void SnapshotMap<T, key_member>::put(const T& value) {
+    Table& t = *table.load();
+    const T* version = new T(value);
+    auto& slot = t.slots[probe(t, value.*key_member)];
+    if (const T* old = slot.load()) {
+        slot.store(version);
+        reclaimer.retire([old] { delete old; });
+    } else {
+        insert(t, version);
+        if (t.used * 2 > t.slots.size()) rehash();
+    }
+    reclaimer.advance();
+}
+template <class T, auto key_member>
+void SnapshotMap<T, key_member>::erase(const Key& key) {
+    Table& t = *table.load();
+    auto& slot = t.slots[probe(t, key)];
+    const T* old = slot.load();
+    if (!old) return;
+    slot.store(tombstone());
+    --t.size;
+    reclaimer.retire([old] { delete old; });
+    reclaimer.advance();
+}
+
+template <class T, auto key_member>
+uint64_t SnapshotMap<T, key_member>::hash(const Key& key) {
+    // FNV-1a, followed by the finalizer of splitmix64 to mix the bytes into the low bits
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&key);
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(Key); i++) {
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+    }
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+template <class T, auto key_member>
+size_t SnapshotMap<T, key_member>::probe(const Table& t, const Key& key) {
+    const size_t mask = t.slots.size() - 1;
+    for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+        const T* version = t.slots[i].load();
+        if (!version || (version != tombstone() && version->*key_member == key)) return i;
+    }
+}
+template <class T, auto key_member>
+void SnapshotMap<T, key_member>::insert(Table& t, const T* version) {
+    const size_t mask = t.slots.size() - 1;
+    // a new key may take the first tombstone on its way
+    for (size_t i = hash(version->*key_member) & mask;; i = (i + 1) & mask) {
+        const T* other = t.slots[i].load();
+        if (!other || other == tombstone()) {
+            if (!other) ++t.used;
+            ++t.size;
+            t.slots[i].store(version);
+            return;
+        }
+    }
+}
+template <class T, auto key_member>
+void SnapshotMap<T, key_member>::rehash() {
+    Table* old = table.load();
+    auto* t = new Table(std::max(MIN_CAPACITY, std::bit_ceil(old->size * 4)));
+    for (const auto& slot : old->slots) {
+        const T* version = slot.load();
+        if (version && version != tombstone()) insert(*t, version);
+    }
+    table.store(t);
+    // the versions are moved, and only the old slots are freed
+    reclaimer.retire([old] { delete old; });
+}
+
+#endif  // BOOKSTORE_SNAPSHOTMAP_HPP
@@ -3,7 +3,9 @@
 
 #include <array>
 
-#include "BlockList.hpp"
+#include "HashIndex.hpp"
+#include "MemoryRiver.hpp"
+#include "SharedMutex.hpp"
 
 // Structure for user
 struct User {
@@ -30,6 +32,9 @@ struct User {
 };
 
 // A Singleton class for manipulating the data of users.
+//
+// It may be used from several threads at once: lookups run concurrently, and a modification
+// excludes everything else.
 class UsersManager {
 public:
     // Returns the singleton for UsersManager.
@@ -58,9 +63,26 @@ public:
     // Hack function for testing.
     void reset();
 
+    // The file of the users, whose only info is USER_DATA_MAGIC ("USER"), so that migrate_index
+    // can tell it from the BlockList of older versions.
+    using UserData = MemoryRiver<User, 1, MappedFile>;
+    static constexpr int USER_DATA_MAGIC = 0x52455355;
+    // Returns true if file_name is a file of the users in the current format.
+    static bool isUserDataFile(const std::string& file_name) {
+        return UserData::peekInfo(file_name, 1) == USER_DATA_MAGIC;
+    }
+
 private:
-    // XXX(llx) maybe we can use int to save in block list?
-    BlockList<User::USERID_T, User> user_data;
+    // Shared by lookups and held exclusively by modifications.
+    SharedMutex mutex;
+    // The primary data for all users
+    UserData user_data;
+    // The index from userid to the index in user_data
+    HashIndex<User::USERID_T, int, MappedFile> userid_index;
+
+    // Returns the index of the user in user_data. Throws if no such user exists.
+    // The caller must hold mutex.
+    int getIdByUserid(const User::USERID_T& userid);
     UsersManager();
     ~UsersManager() = default;
 };
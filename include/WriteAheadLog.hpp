@@ -0,0 +1,209 @@
+#ifndef BOOKSTORE_WRITEAHEADLOG_HPP
+#define BOOKSTORE_WRITEAHEADLOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SharedMutex.hpp"
+
+class PagedFile;
+
+// A redo log shared by all data files, which makes the writes of each transaction atomic and
+// durable.
+//
+// While the log is open, the storage backends (PagedFile and MappedFile) keep their writes in
+// memory and append them to the log instead of writing them to their files. A background thread
+// commits the writes in batches: it appends a batch to the log with a single sync, and only then
+// writes it to the files, so a file never holds a write that the log may lose. A transaction never
+// spans two batches. After a crash, opening the log again replays the complete batches in it, which
+// restores the files to the end of the last batch committed. The log is truncated whenever the
+// files are synced (a checkpoint).
+//
+// A batch has a header (MAGIC, the size and the epoch of the batch, and the checksum of the rest),
+// the names of the files in it, and the writes: the index of the file, the position, the length and
+// the bytes.
+class WriteAheadLog {
+public:
+    // The unit in which the writes not committed yet are kept in memory.
+    static constexpr int PAGE_SIZE = 4096;
+    // The background thread commits the pending writes at least this often, and at once when a
+    // transaction waits for them or when they reach MAX_BATCH_SIZE bytes.
+    static constexpr auto COMMIT_INTERVAL = std::chrono::milliseconds(10);
+    static constexpr size_t MAX_BATCH_SIZE = 4 << 20;
+    // The size of the log beyond which the files are synced and the log is truncated.
+    static constexpr long long CHECKPOINT_SIZE = 64 << 20;
+
+    // Whether a transaction waits until its writes are committed when it ends. An ASYNC
+    // transaction returns at once, and is committed within COMMIT_INTERVAL. A crash may lose the
+    // last transactions, but never a part of one.
+    enum class Durability { SYNC, ASYNC };
+
+    static WriteAheadLog& getInstance();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Replays the batches in the log at path onto their files, and starts logging the writes to the
+    // files opened afterwards. The files in the log must not be open. A torn batch at the end of
+    // the log is discarded. Returns the number of batches replayed.
+    size_t open(const std::string& path, Durability durability = Durability::SYNC);
+    // Commits all writes, syncs the files and truncates the log. The files opened while the log was
+    // open are written directly afterwards. No file may be written while the log is closing.
+    void close();
+    bool isOpen() const { return running; }
+    // Blocks until all writes so far are committed and written to their files.
+    void flush();
+    // Returns the number of batches appended to the log, each of which is synced once.
+    size_t getCommitCount() const { return commit_count; }
+
+    // Makes the writes of the calling thread in its scope one atomic unit, and waits until they are
+    // committed when it ends, unless the log is ASYNC. Transactions may be nested, in which case
+    // only the outermost one counts. Writes outside any transaction are committed individually, and
+    // nobody waits for them.
+    //
+    // A transaction must not begin while the thread holds a lock that another transaction may wait
+    // for, since committing a batch waits until the transactions in it end.
+    class Transaction {
+    public:
+        Transaction();
+        ~Transaction();
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+    private:
+        // Whether this is the outermost transaction, which holds the gate of the log.
+        bool outermost = false;
+    };
+
+    // The writes to a file that are not written to it yet. While the log is open, each storage
+    // backend that is opened passes its reads and writes through one.
+    class FileLog {
+    public:
+        // Accesses the file itself, bypassing the log.
+        struct Backend {
+            std::function<void(char*, long long, size_t)> read;
+            std::function<void(const char*, long long, size_t)> write;
+            // Makes the writes to the file durable.
+            std::function<void()> sync;
+        };
+
+        FileLog(WriteAheadLog& _log, std::string _name, Backend _backend)
+            : log(_log), name(std::move(_name)), backend(std::move(_backend)) {}
+        FileLog(const FileLog&) = delete;
+        FileLog& operator=(const FileLog&) = delete;
+
+        // Reads len bytes at pos, including the writes not written to the file yet.
+        void read(char* dst, long long pos, size_t len);
+        // Appends the write to the log. It is visible to read() at once.
+        void write(const char* src, long long pos, size_t len);
+        // Returns the end of the last write, which may not be written to the file yet.
+        long long size() const { return end; }
+        // Writes all writes to the file and syncs it. The file is no longer logged.
+        void close();
+
+    private:
+        friend class WriteAheadLog;
+        struct Page {
+            // The epoch of the last write to the page.
+            uint64_t epoch;
+            std::vector<char> data;
+        };
+
+        WriteAheadLog& log;
+        const std::string name;
+        const Backend backend;
+        // Shared by reads, and held exclusively while the pages or the file are modified.
+        SharedMutex mutex;
+        // The pages with writes not written to the file yet, by page number.
+        std::unordered_map<long long, Page> pages;
+        std::atomic<long long> end = 0;
+        // Set once the log is closed, after which the writes go to the file directly.
+        bool detached = false;
+    };
+
+    // Starts logging the file name with backend. Called by the storage backends when they open a
+    // file, if the log is open.
+    std::unique_ptr<FileLog> attach(const std::string& name, FileLog::Backend backend);
+
+private:
+    static constexpr uint32_t MAGIC = 0x314c4157;  // "WAL1"
+    struct Header {
+        uint32_t magic;
+        uint32_t size;
+        uint64_t epoch;
+        uint64_t checksum;
+    };
+    // A write in a batch. The bytes are at offset in the data of the batch.
+    struct Entry {
+        FileLog* file;
+        long long pos;
+        size_t offset;
+        size_t len;
+    };
+    struct Batch {
+        uint64_t epoch = 0;
+        std::vector<Entry> entries;
+        std::string data;
+    };
+
+    std::unique_ptr<PagedFile> file;
+    long long log_size = 0;
+    std::atomic<bool> running = false;
+    Durability durability = Durability::SYNC;
+    std::atomic<size_t> commit_count = 0;
+    // Held shared by the transactions, and exclusively while a batch is sealed, so that a batch
+    // ends between transactions.
+    SharedMutex gate;
+    // Guards the fields below.
+    std::mutex mutex;
+    std::condition_variable cv;
+    // The writes of the current epoch, which are sealed into the next batch.
+    Batch current;
+    uint64_t epoch = 1;
+    // All epochs up to these are committed, and written to the files.
+    uint64_t durable_epoch = 0;
+    uint64_t applied_epoch = 0;
+    // The last epoch that a thread waits for.
+    uint64_t requested_epoch = 0;
+    bool stopping = false;
+    std::thread committer;
+    // Guards files.
+    std::mutex files_mutex;
+    std::vector<FileLog*> files;
+
+    // The depth of the transactions of the thread, and the epoch of their writes.
+    static thread_local int transaction_depth;
+    static thread_local uint64_t transaction_epoch;
+
+    WriteAheadLog() = default;
+    ~WriteAheadLog();
+
+    // Appends a write of file to the current epoch, and returns the epoch.
+    uint64_t append(FileLog* file, const char* src, long long pos, size_t len);
+    // Blocks until epoch is committed, and also written to the files if applied is true.
+    void waitFor(uint64_t epoch, bool applied);
+    // The loop of the background thread.
+    void runCommitter();
+    // Takes the writes of the current epoch, and starts the next epoch.
+    Batch seal();
+    // Appends batch to the log and syncs it.
+    void commit(const Batch& batch);
+    // Writes the writes of a committed batch to their files.
+    void apply(const Batch& batch);
+    // Syncs all files and truncates the log.
+    void checkpoint();
+    // Replays the log onto the files. Returns the number of batches replayed.
+    size_t recover();
+};
+
+#endif  // BOOKSTORE_WRITEAHEADLOG_HPP
@@ -1,124 +1,417 @@
 #include "BooksManager.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <filesystem>
-#include <ranges>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include "Utils.hpp"
 
+namespace {
+// Returns true if book satisfies the keyword conditions of query.
+bool matchesKeywords(const Book& book, const BookQuery& query) {
+    const auto keywords = util::split(book.keywords.data());
+    auto has = [&keywords](const Book::KEYWORD_T& keyword) {
+        return std::ranges::find(keywords, util::toString(keyword)) != keywords.end();
+    };
+    return std::ranges::all_of(query.keywords, has) &&
+           (query.any_keywords.empty() || std::ranges::any_of(query.any_keywords, has)) &&
+           std::ranges::none_of(query.excluded_keywords, has);
+}
+}  // namespace
+
 BooksManager& BooksManager::getInstance() {
     static BooksManager instance;
     return instance;
 }
 std::vector<Book> BooksManager::getBooksWithISBN(const Book::ISBN_T& ISBN) {
-    const std::vector<int> ids = isbn_index.query(ISBN);
-    return getBooksByIds(ids);
+    if (snapshots_enabled) {
+        const auto book = snapshots.find(ISBN);
+        if (!book) return {};
+        return {*book};
+    }
+    std::shared_lock lock(mutex);
+    const int id = findId(ISBN);
+    if (!id) return {};
+    return {readBook(id)};
 }
 std::vector<Book> BooksManager::getBooksWithName(const Book::BOOKNAME_T& name) {
-    const std::vector<int> ids = book_name_index.query(name);
-    return getBooksByIds(ids);
+    std::vector<Book> books;
+    forEachBookWithName(name, [&books](const Book& book) { books.push_back(book); });
+    return books;
 }
 std::vector<Book> BooksManager::getBooksWithAuthor(const Book::AUTHOR_T& author) {
-    const std::vector<int> ids = author_index.query(author);
-    return getBooksByIds(ids);
+    std::vector<Book> books;
+    forEachBookWithAuthor(author, [&books](const Book& book) { books.push_back(book); });
+    return books;
 }
 std::vector<Book> BooksManager::getBooksWithKeyword(const Book::KEYWORD_T& keyword) {
-    const std::vector<int> ids = keyword_index.query(keyword);
-    return getBooksByIds(ids);
+    std::vector<Book> books;
+    forEachBookWithKeyword(keyword, [&books](const Book& book) { books.push_back(book); });
+    return books;
 }
 std::vector<Book> BooksManager::getAllBooks() {
-    const std::vector<int> ids = book_name_index.queryAll();
-    return getBooksByIds(ids);
+    std::vector<Book> books;
+    forEachBook([&books](const Book& book) { books.push_back(book); });
+    return books;
 }
 void BooksManager::createBook(const Book::ISBN_T& ISBN) {
     Book new_book;
     new_book.ISBN = ISBN;
+    std::unique_lock lock(mutex);
     writeData(new_book);
 }
 void BooksManager::modifyBookData(const Book::ISBN_T& ISBN_before, const Book& data_new) {
-    removeData(ISBN_before);
-    writeData(data_new);
+    std::unique_lock lock(mutex);
+    const int id = findId(ISBN_before);
+    if (!id) {
+        writeData(data_new);
+        return;
+    }
+    const Book data_old = readBook(id);
+    if (data_new.ISBN != data_old.ISBN) {
+        // check before anything is modified, so that the book is kept if it fails
+        if (findId(data_new.ISBN)) {
+            throw std::runtime_error("ISBN Already Exists");
+        }
+        isbn_hash.erase(data_old.ISBN);
+        isbn_hash.insert(data_new.ISBN, id);
+        isbn_index.erase(data_old.ISBN, id);
+        isbn_index.insert(data_new.ISBN, id);
+    }
+    if (data_new.book_name != data_old.book_name) {
+        book_name_index.erase(data_old.book_name, id);
+        book_name_index.insert(data_new.book_name, id);
+        updateNgrams(NAME_NGRAM, data_old.book_name.data(), data_new.book_name.data(), id);
+    }
+    if (data_new.author != data_old.author) {
+        author_index.erase(data_old.author, id);
+        author_index.insert(data_new.author, id);
+        updateNgrams(AUTHOR_NGRAM, data_old.author.data(), data_new.author.data(), id);
+    }
+    if (data_new.price != data_old.price) {
+        price_index.erase(data_old.price, id);
+        price_index.insert(data_new.price, id);
+    }
+    if (data_new.quantity != data_old.quantity) {
+        quantity_index.erase(data_old.quantity, id);
+        quantity_index.insert(data_new.quantity, id);
+    }
+    if (data_new.keywords != data_old.keywords) {
+        // only the keywords added or removed are updated
+        const auto keywords_old = util::split(data_old.keywords.data());
+        const auto keywords_new = util::split(data_new.keywords.data());
+        for (const auto& keyword : keywords_old) {
+            if (std::ranges::find(keywords_new, keyword) == keywords_new.end()) {
+                keyword_index.erase(util::toArray<Book::KEYWORD_T>(keyword), id);
+            }
+        }
+        for (const auto& keyword : keywords_new) {
+            if (std::ranges::find(keywords_old, keyword) == keywords_old.end()) {
+                keyword_index.insert(util::toArray<Book::KEYWORD_T>(keyword), id);
+            }
+        }
+    }
+    // the record is rewritten in place, so the id of the book stays the same
+    if (data_new == data_old) return;
+    main_data.update(data_new, id);
+    if (snapshots_enabled) {
+        snapshots.put(data_new);
+        if (data_new.ISBN != data_old.ISBN) snapshots.erase(data_old.ISBN);
+    }
 }
 void BooksManager::importBook(const Book::ISBN_T& ISBN, int quantity_imported) {
-    int id = getIdByISBN(ISBN);
+    std::unique_lock lock(mutex);
+    int id = findId(ISBN);
     int quantity_now;
     main_data.read(quantity_now, id, offsetof(Book, quantity));
     main_data.update(quantity_now + quantity_imported, id, offsetof(Book, quantity));
+    quantity_index.erase(quantity_now, id);
+    quantity_index.insert(quantity_now + quantity_imported, id);
+    publish(id);
 }
-bool BooksManager::buyBook(const Book::ISBN_T& ISBN, int quantity_bought) {
-    int id = getIdByISBN(ISBN);
+Purchase BooksManager::tryBuy(const Book::ISBN_T& ISBN, int quantity_bought) {
+    // the other modifications are excluded by mutex, and the purchases of the book by its stripe
+    std::shared_lock lock(mutex);
+    const int id = findId(ISBN);
+    if (!id) return {};
+    std::lock_guard stripe_lock(purchase_mutexes[id % PURCHASE_STRIPES]);
+    long long price;
     int quantity_now;
+    main_data.read(price, id, offsetof(Book, price));
     main_data.read(quantity_now, id, offsetof(Book, quantity));
-    if (quantity_now < quantity_bought) {
-        return false;
+    if (quantity_now < quantity_bought) return {Purchase::OUT_OF_STOCK, price, quantity_now};
+    const int quantity_left = quantity_now - quantity_bought;
+    main_data.update(quantity_left, id, offsetof(Book, quantity));
+    {
+        std::unique_lock quantity_lock(quantity_mutex);
+        quantity_index.erase(quantity_now, id);
+        quantity_index.insert(quantity_left, id);
     }
-    main_data.update(quantity_now - quantity_bought, id, offsetof(Book, quantity));
-    return true;
+    if (snapshots_enabled) {
+        // the new version differs from the published one only in its quantity
+        std::lock_guard snapshots_lock(snapshots_mutex);
+        const auto published = snapshots.find(ISBN);
+        Book book;
+        if (published) {
+            book = *published;
+        } else {
+            main_data.read(book, id);  // readBook would take the stripe again
+        }
+        book.quantity = quantity_left;
+        snapshots.put(book);
+    }
+    return {Purchase::SUCCESS, price, quantity_left};
+}
+bool BooksManager::buyBook(const Book::ISBN_T& ISBN, int quantity_bought) {
+    return tryBuy(ISBN, quantity_bought).status == Purchase::SUCCESS;
+}
+void BooksManager::enableSnapshots() {
+    std::unique_lock lock(mutex);
+    if (snapshots_enabled) return;
+    for (const auto& [ISBN, id] : std::ranges::subrange(isbn_index.begin(), isbn_index.end())) {
+        snapshots.put(readBook(id));
+    }
+    snapshots_enabled = true;
 }
 void BooksManager::reset() {
     this->~BooksManager();
     std::filesystem::remove("book_data");
+    std::filesystem::remove("book_ISBN_hash");
     std::filesystem::remove("book_ISBN_index");
     std::filesystem::remove("book_name_index");
     std::filesystem::remove("book_author_index");
+    std::filesystem::remove("book_price_index");
+    std::filesystem::remove("book_quantity_index");
     std::filesystem::remove("book_keyword_index");
+    std::filesystem::remove("book_keyword_index_postings");
+    std::filesystem::remove("book_ngram_index");
+    std::filesystem::remove("book_ngram_index_postings");
     new (this) BooksManager();
 }
 Book BooksManager::getBookById(int id) {
-    Book book_now;
-    main_data.read(book_now, id);
-    return book_now;
+    std::shared_lock lock(mutex);
+    return readBook(id);
 }
 
 std::vector<Book> BooksManager::getBooksByIds(const std::vector<int>& ids) {
+    std::shared_lock lock(mutex);
     std::vector<Book> books;
-    for (const int id : ids) {
-        Book book_now;
-        main_data.read(book_now, id);
-        books.push_back(book_now);
-    }
-    // XXX(llx) maybe the memory limit is not enough for storing all books in a vector?
-    std::ranges::sort(books, {}, &Book::ISBN);
+    forEachBookByIds(ids, [&books](const Book& book) { books.push_back(book); });
     return books;
 }
-int BooksManager::getIdByISBN(const Book::ISBN_T& ISBN) {
-    const std::vector<int> ids = isbn_index.query(ISBN);
-    assert(ids.size() <= 1);
-    if (ids.empty()) return 0;
-    return ids[0];
-}
-void BooksManager::removeData(const Book::ISBN_T& ISBN) {
-    int id = getIdByISBN(ISBN);
-    if(!id)return;
-    Book book;
-    main_data.read(book, id);
-    isbn_index.erase(book.ISBN, id);
-    book_name_index.erase(book.book_name, id);
-    author_index.erase(book.author, id);
-    auto keywords_list = util::split(book.keywords.data());
-    for (const auto& keyword : keywords_list) {
-        keyword_index.erase(util::toArray<Book::KEYWORD_T>(keyword), id);
+std::vector<int> BooksManager::findIds(const BookQuery& query) {
+    struct Condition {
+        size_t estimate;  // the estimated number of matching books
+        std::function<std::vector<int>()> lookup;
+        std::function<bool(const Book&)> check;
+        // Whether lookup returns exactly the matching books, rather than candidates to check.
+        bool exact = true;
+    };
+    std::vector<Condition> conditions;
+    if (query.ISBN) {
+        const int id = findId(*query.ISBN);
+        conditions.push_back({id ? 1u : 0u,
+                              [id] { return id ? std::vector<int>{id} : std::vector<int>{}; },
+                              [&query](const Book& book) { return book.ISBN == *query.ISBN; }});
+    }
+    if (query.name) {
+        conditions.push_back(
+            {book_name_index.count(*query.name, ESTIMATE_LIMIT),
+             [this, &query] { return book_name_index.query(*query.name); },
+             [&query](const Book& book) { return book.book_name == *query.name; }});
+    }
+    if (query.author) {
+        conditions.push_back({author_index.count(*query.author, ESTIMATE_LIMIT),
+                              [this, &query] { return author_index.query(*query.author); },
+                              [&query](const Book& book) { return book.author == *query.author; }});
+    }
+    // the keyword conditions are looked up together by merging the lists of keyword_index
+    if (!query.keywords.empty() || !query.any_keywords.empty()) {
+        size_t estimate = 0;
+        if (!query.keywords.empty()) {
+            estimate = keyword_index.count(query.keywords.front());
+            for (const auto& keyword : query.keywords) {
+                estimate = std::min(estimate, keyword_index.count(keyword));
+            }
+        } else {
+            for (const auto& keyword : query.any_keywords) estimate += keyword_index.count(keyword);
+        }
+        conditions.push_back({estimate,
+                              [this, &query] {
+                                  return keyword_index.query(query.keywords, query.any_keywords,
+                                                             query.excluded_keywords);
+                              },
+                              [&query](const Book& book) { return matchesKeywords(book, query); }});
+    } else if (!query.excluded_keywords.empty()) {
+        // excluding keywords alone matches most books
+        conditions.push_back({static_cast<size_t>(isbn_hash.size()),
+                              [this, &query] {
+                                  const std::vector<int> ids = getAllIds();
+                                  const std::vector<int> excluded =
+                                      keyword_index.query({}, query.excluded_keywords);
+                                  std::vector<int> difference;
+                                  std::ranges::set_difference(ids, excluded,
+                                                              std::back_inserter(difference));
+                                  return difference;
+                              },
+                              [&query](const Book& book) { return matchesKeywords(book, query); }});
+    }
+    // a string shorter than an n-gram is checked on all books
+    auto addSubstring = [this, &conditions](char field, std::string_view str, auto member) {
+        const auto ngrams = getNgrams(field, str);
+        size_t estimate = isbn_hash.size();
+        for (const auto& ngram : ngrams) estimate = std::min(estimate, ngram_index.count(ngram));
+        conditions.push_back({estimate,
+                              [this, ngrams] {
+                                  if (ngrams.empty()) return getAllIds();
+                                  return ngram_index.query(ngrams, {});
+                              },
+                              [str, member](const Book& book) {
+                                  const std::string_view value((book.*member).data());
+                                  return value.find(str) != std::string_view::npos;
+                              },
+                              false});
+    };
+    if (query.name_contains) {
+        addSubstring(NAME_NGRAM, query.name_contains->data(), &Book::book_name);
+    }
+    if (query.author_contains) {
+        addSubstring(AUTHOR_NGRAM, query.author_contains->data(), &Book::author);
+    }
+    // the entries in a range are counted up to ESTIMATE_LIMIT
+    auto addRange = [this, &conditions](auto& index, auto lo, auto hi, auto member) {
+        size_t estimate = 0;
+        auto entries = index.range(lo, hi);
+        for (auto it = entries.begin(); it != entries.end() && estimate < ESTIMATE_LIMIT; ++it) {
+            ++estimate;
+        }
+        conditions.push_back({estimate,
+                              [&index, lo, hi] {
+                                  std::vector<int> ids;
+                                  for (const auto& [key, id] : index.range(lo, hi)) {
+                                      ids.push_back(id);
+                                  }
+                                  std::ranges::sort(ids);
+                                  return ids;
+                              },
+                              [lo, hi, member](const Book& book) {
+                                  return lo <= book.*member && book.*member <= hi;
+                              }});
+    };
+    if (query.min_price || query.max_price) {
+        addRange(price_index, query.min_price.value_or(std::numeric_limits<long long>::min()),
+                 query.max_price.value_or(std::numeric_limits<long long>::max()), &Book::price);
+    }
+    // concurrent purchases move the books in quantity_index
+    std::shared_lock quantity_lock(quantity_mutex, std::defer_lock);
+    if (query.min_quantity || query.max_quantity) {
+        quantity_lock.lock();
+        addRange(quantity_index, query.min_quantity.value_or(std::numeric_limits<int>::min()),
+                 query.max_quantity.value_or(std::numeric_limits<int>::max()), &Book::quantity);
+    }
+    assert(!conditions.empty());
+
+    std::ranges::stable_sort(conditions, {}, &Condition::estimate);
+    // the values of a key in an index are in ascending order
+    std::vector<int> ids = conditions.front().lookup();
+    std::vector<const Condition*> checks;
+    if (!conditions.front().exact) checks.push_back(&conditions.front());
+    for (auto it = conditions.begin() + 1; it != conditions.end() && !ids.empty(); ++it) {
+        if (ids.size() * FILTER_RATIO <= it->estimate || !it->exact) {
+            checks.push_back(&*it);
+        }
+        if (ids.size() * FILTER_RATIO <= it->estimate) continue;
+        const std::vector<int> other = it->lookup();
+        std::vector<int> intersection;
+        std::ranges::set_intersection(ids, other, std::back_inserter(intersection));
+        ids = std::move(intersection);
+    }
+    // purchases take quantity_mutex while holding a stripe, which readBook takes below
+    if (quantity_lock.owns_lock()) quantity_lock.unlock();
+    if (!checks.empty()) {
+        std::erase_if(ids, [this, &checks](int id) {
+            const Book book = readBook(id);
+            return !std::ranges::all_of(checks,
+                                        [&book](const Condition* c) { return c->check(book); });
+        });
     }
-    main_data.erase(id);
+    return ids;
+}
+int BooksManager::getIdByISBN(const Book::ISBN_T& ISBN) {
+    std::shared_lock lock(mutex);
+    return findId(ISBN);
 }
 void BooksManager::writeData(const Book& book) {
-    if (getIdByISBN(book.ISBN)) {
+    if (findId(book.ISBN)) {
         throw std::runtime_error("ISBN Already Exists");
     }
     int id = main_data.write(book);
+    isbn_hash.insert(book.ISBN, id);
     isbn_index.insert(book.ISBN, id);
     book_name_index.insert(book.book_name, id);
     author_index.insert(book.author, id);
+    price_index.insert(book.price, id);
+    quantity_index.insert(book.quantity, id);
     auto keywords_list = util::split(book.keywords.data());
     for (const auto& keyword : keywords_list) {
         keyword_index.insert(util::toArray<Book::KEYWORD_T>(keyword), id);
     }
+    updateNgrams(NAME_NGRAM, "", book.book_name.data(), id);
+    updateNgrams(AUTHOR_NGRAM, "", book.author.data(), id);
+    if (snapshots_enabled) snapshots.put(book);
+}
+void BooksManager::updateNgrams(char field, std::string_view before, std::string_view after,
+                                int id) {
+    const auto ngrams_old = getNgrams(field, before);
+    const auto ngrams_new = getNgrams(field, after);
+    std::vector<NGRAM_T> removed, added;
+    std::ranges::set_difference(ngrams_old, ngrams_new, std::back_inserter(removed));
+    std::ranges::set_difference(ngrams_new, ngrams_old, std::back_inserter(added));
+    for (const auto& ngram : removed) ngram_index.erase(ngram, id);
+    for (const auto& ngram : added) ngram_index.insert(ngram, id);
+}
+std::vector<int> BooksManager::getAllIds() {
+    std::vector<int> ids;
+    for (const auto& [ISBN, id] : std::ranges::subrange(isbn_index.begin(), isbn_index.end())) {
+        ids.push_back(id);
+    }
+    std::ranges::sort(ids);
+    return ids;
+}
+Book BooksManager::readBook(int id) {
+    std::lock_guard stripe_lock(purchase_mutexes[id % PURCHASE_STRIPES]);
+    Book book;
+    main_data.read(book, id);
+    return book;
+}
+int BooksManager::findId(const Book::ISBN_T& ISBN) {
+    return isbn_hash.find(ISBN).value_or(0);
+}
+void BooksManager::publish(int id) {
+    if (snapshots_enabled) snapshots.put(readBook(id));
+}
+bool BooksManager::isSnapshotLookup(const BookQuery& query) const {
+    if (!snapshots_enabled || !query.ISBN) return false;
+    BookQuery rest = query;
+    rest.ISBN.reset();
+    return rest.empty();
 }
 
 BooksManager::BooksManager() {
     main_data.initialise("book_data");
+    isbn_hash.initialise("book_ISBN_hash");
     isbn_index.initialise("book_ISBN_index");
     book_name_index.initialise("book_name_index");
     author_index.initialise("book_author_index");
+    price_index.initialise("book_price_index");
+    quantity_index.initialise("book_quantity_index");
     keyword_index.initialise("book_keyword_index");
+    ngram_index.initialise("book_ngram_index");
 }
\ No newline at end of file
@@ -1,135 +1,144 @@
 #include "Commands/BookCommands.hpp"
 
-#include "Utils.hpp"
-
-void ShowCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str = "show";
-    if (ISBN.has_value()) command_str = command_str + " -ISBN=" + util::toString(ISBN.value());
-    if (name.has_value()) command_str = command_str + " -name=" + util::toString(name.value());
-    if (author.has_value())
-        command_str = command_str + " -author=" + util::toString(author.value());
-    if (keyword.has_value())
-        command_str = command_str + " -keyword=" + util::toString(keyword.value());
+#include <utility>
 
-    int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 1) {
-        throw ExecutionException("show error: privilege not enough to operate.");
-    }
+#include "Utils.hpp"
+#include "WriteAheadLog.hpp"
 
+void ShowCommand::run(ExecutionContext& ctx, std::ostream& os) {
     auto output = [&os](const auto& str) {
         for (auto it = str.begin(); *it; it++) {
             os << (*it);
         }
     };
 
-    std::vector<Book> books;
-    if (ISBN.has_value()) {
-        books = bk_mgr.getBooksWithISBN(ISBN.value());
-    } else if (name.has_value()) {
-        books = bk_mgr.getBooksWithName(name.value());
-    } else if (author.has_value()) {
-        books = bk_mgr.getBooksWithAuthor(author.value());
-    } else if (keyword.has_value()) {
-        books = bk_mgr.getBooksWithKeyword(keyword.value());
-    } else {
-        books = bk_mgr.getAllBooks();
-    }
-    if (books.empty()) {
-        os << "\n";
-    } else {
-        for (auto& book : books) {
-            output(book.ISBN);
-            os << '\t';
-            output(book.book_name);
-            os << '\t';
-            output(book.author);
-            os << '\t';
-            output(book.keywords);
-            os << '\t';
-            util::outputDecimal(os, book.price);
-            os << '\t';
-            os << book.quantity;
-            os << '\n';
-        }
+    // the books are printed as they are read
+    bool found = false;
+    forEach(ctx, [&os, &output, &found](const Book& book) {
+        found = true;
+        output(book.ISBN);
+        os << '\t';
+        output(book.book_name);
+        os << '\t';
+        output(book.author);
+        os << '\t';
+        output(book.keywords);
+        os << '\t';
+        util::outputDecimal(os, book.price);
+        os << '\t';
+        os << book.quantity;
+        os << '\n';
+    });
+    if (!found) os << "\n";
+}
+bool ShowCommand::forEachResult(ExecutionContext& ctx,
+                                const std::function<void(const Book&)>& func) {
+    // the server calls it without execute()
+    WriteAheadLog::Transaction transaction;
+    resolveUser(ctx);
+    return forEach(ctx, func);
+}
+bool ShowCommand::forEach(const ExecutionContext& ctx,
+                          const std::function<void(const Book&)>& func) {
+    Log::Operation op(Log::OpCode::SHOW);
+    if (ISBN.has_value()) op.add(Log::Field::ISBN, util::toString(ISBN.value()));
+    if (name.has_value()) op.add(Log::Field::NAME, util::toString(name.value()));
+    if (author.has_value()) op.add(Log::Field::AUTHOR, util::toString(author.value()));
+    for (const auto& keyword : keywords) op.add(Log::Field::KEYWORD, util::toString(keyword));
+    for (const auto& keyword : any_keywords) {
+        op.add(Log::Field::ANY_KEYWORD, util::toString(keyword));
+    }
+    for (const auto& keyword : excluded_keywords) {
+        op.add(Log::Field::EXCLUDED_KEYWORD, util::toString(keyword));
+    }
+    if (name_contains) op.add(Log::Field::NAME_CONTAINS, util::toString(*name_contains));
+    if (author_contains) op.add(Log::Field::AUTHOR_CONTAINS, util::toString(*author_contains));
+    if (min_price) op.add(Log::Field::MIN_PRICE, *min_price);
+    if (max_price) op.add(Log::Field::MAX_PRICE, *max_price);
+    if (min_quantity) op.add(Log::Field::MIN_QUANTITY, *min_quantity);
+    if (max_quantity) op.add(Log::Field::MAX_QUANTITY, *max_quantity);
+    if (page.after) op.add(Log::Field::CURSOR, util::toString(*page.after));
+    if (page.limit != BookPage{}.limit) {
+        op.add(Log::Field::LIMIT, static_cast<long long>(page.limit));
     }
 
+    int log_id = LogManager::getInstance().addOperationLog(
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 1) {
+        throw ExecutionException("show error: privilege not enough to operate.");
+    }
+
+    const BookQuery query{ISBN, name, author, keywords, any_keywords, excluded_keywords,
+                          name_contains, author_contains, min_price, max_price, min_quantity,
+                          max_quantity};
+    const bool has_more = bk_mgr().forEachBookMatching(query, func, page);
+
     LogManager::getInstance().markOperationSuccess(log_id);
+    return has_more;
 }
 
-void BuyCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str =
-        "buy -ISBN=" + util::toString(ISBN) + " -quantity=" + std::to_string(quantity);
+void BuyCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::BUY);
+    op.add(Log::Field::ISBN, util::toString(ISBN)).add(Log::Field::QUANTITY, quantity);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
 
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 1) {
+    if (ctx.privilege() < 1) {
         throw ExecutionException("buy error: privilege not enough to operate.");
     }
-    auto result = bk_mgr.getBooksWithISBN(ISBN);
-    if (result.empty()) {
+    const Purchase purchase = bk_mgr().tryBuy(ISBN, quantity);
+    if (purchase.status == Purchase::NO_BOOK) {
         throw ExecutionException("buy error: book with ISBN doesn't exist");
     }
-    auto book = result.front();
-    if (book.quantity < quantity) {
+    if (purchase.status == Purchase::OUT_OF_STOCK) {
         throw ExecutionException("buy error: quantity is more than quantity in storage");
     }
 
-    bk_mgr.buyBook(ISBN, quantity);
-
-    long long money_need = book.price * quantity;
+    long long money_need = purchase.price * quantity;
     util::outputDecimal(os, money_need);
     os << "\n";
-    log_mgr.addFinanceLog(util::getTimestamp(), current_userid, money_need);
+    log_mgr().addFinanceLog(util::getTimestamp(), ctx.userid(), money_need);
     LogManager::getInstance().markOperationSuccess(log_id);
 }
 BuyCommand::BuyCommand(const Book::ISBN_T& _ISBN, int _quantity)
     : ISBN(_ISBN), quantity(_quantity) {}
 
-void SelectCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str = "select -ISBN=" + util::toString(ISBN);
+void SelectCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::SELECT);
+    op.add(Log::Field::ISBN, util::toString(ISBN));
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 3) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 3) {
         throw ExecutionException("select error: privilege not enough to operate.");
     }
 
-    auto result = bk_mgr.getIdByISBN(ISBN);
+    auto result = bk_mgr().getIdByISBN(ISBN);
     if (!result) {
-        bk_mgr.createBook(ISBN);
-        result = bk_mgr.getIdByISBN(ISBN);
+        bk_mgr().createBook(ISBN);
+        result = bk_mgr().getIdByISBN(ISBN);
     }
-    current_bookid = result;
+    ctx.selected_id = result;
     LogManager::getInstance().markOperationSuccess(log_id);
 }
 SelectCommand::SelectCommand(const Book::ISBN_T& _ISBN) : ISBN(_ISBN) {}
 
-void ModifyCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str = "modify";
-    if (new_ISBN.has_value())
-        command_str = command_str + " -ISBN=" + util::toString(new_ISBN.value());
-    if (new_name.has_value())
-        command_str = command_str + " -name=" + util::toString(new_name.value());
-    if (new_author.has_value())
-        command_str = command_str + " -author=" + util::toString(new_author.value());
-    if (new_keyword.has_value())
-        command_str = command_str + " -keyword=" + util::toString(new_keyword.value());
-    if (new_price.has_value())
-        command_str = command_str + " -price=" + std::to_string(new_price.value());
+void ModifyCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::MODIFY);
+    if (new_ISBN.has_value()) op.add(Log::Field::ISBN, util::toString(new_ISBN.value()));
+    if (new_name.has_value()) op.add(Log::Field::NAME, util::toString(new_name.value()));
+    if (new_author.has_value()) op.add(Log::Field::AUTHOR, util::toString(new_author.value()));
+    if (new_keyword.has_value()) op.add(Log::Field::KEYWORD, util::toString(new_keyword.value()));
+    if (new_price.has_value()) op.add(Log::Field::PRICE, new_price.value());
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
 
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 3) {
+    if (ctx.privilege() < 3) {
         throw ExecutionException("modify error: privilege not enough to operate.");
     }
-    if (!current_bookid) {
+    if (!ctx.selected_id) {
         throw ExecutionException("modify error: selected book is empty");
     }
-    Book book_data = bk_mgr.getBookById(current_bookid);
+    Book book_data = bk_mgr().getBookById(ctx.selected_id);
     if (new_ISBN && new_ISBN == book_data.ISBN) {
         throw ExecutionException("modify error: new ISBN mustn't be the same with before");
     }
@@ -149,26 +158,25 @@ void ModifyCommand::execute(User::USERID_T& current_userid, int& current_bookid,
     if (new_price) {
         book_data.price = new_price.value();
     }
-    bk_mgr.modifyBookData(old_ISBN, book_data);
+    bk_mgr().modifyBookData(old_ISBN, book_data);
 
     LogManager::getInstance().markOperationSuccess(log_id);
 }
 
-void ImportCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str = "import -quantity=" + std::to_string(quantity) +
-                              " -total_cost=" + std::to_string(total_cost);
+void ImportCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::IMPORT);
+    op.add(Log::Field::QUANTITY, quantity).add(Log::Field::TOTAL_COST, total_cost);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 3) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 3) {
         throw ExecutionException("import error: privilege not enough to operate.");
     }
-    if (!current_bookid) {
+    if (!ctx.selected_id) {
         throw ExecutionException("modify error: selected book is empty");
     }
-    Book book_data = bk_mgr.getBookById(current_bookid);
-    bk_mgr.importBook(book_data.ISBN, quantity);
-    log_mgr.addFinanceLog(util::getTimestamp(), current_userid, -total_cost);
+    Book book_data = bk_mgr().getBookById(ctx.selected_id);
+    bk_mgr().importBook(book_data.ISBN, quantity);
+    log_mgr().addFinanceLog(util::getTimestamp(), ctx.userid(), -total_cost);
 
     LogManager::getInstance().markOperationSuccess(log_id);
 }
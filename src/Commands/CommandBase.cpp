@@ -1,9 +1,9 @@
 #include "Commands/CommandBase.hpp"
 
-#include "BooksManager.hpp"
-#include "LogManager.hpp"
-#include "UsersManager.hpp"
+#include "WriteAheadLog.hpp"
 
-UsersManager& Command::usr_mgr = UsersManager::getInstance();
-BooksManager& Command::bk_mgr = BooksManager::getInstance();
-LogManager& Command::log_mgr = LogManager::getInstance();
\ No newline at end of file
+void Command::execute(ExecutionContext& ctx, std::ostream& os) {
+    WriteAheadLog::Transaction transaction;
+    resolveUser(ctx);
+    run(ctx, os);
+}
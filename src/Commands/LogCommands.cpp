@@ -1,16 +1,16 @@
 #include "Commands/LogCommands.hpp"
 
+#include <optional>
 #include <tuple>
+#include <utility>
 
 #include "Utils.hpp"
-void ShowFinanceCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                                 std::ostream& os) {
-    std::string command_str = "show finance";
-    if (count.has_value()) command_str = command_str + " -count=" + std::to_string(count.value());
+void ShowFinanceCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::SHOW_FINANCE);
+    if (count.has_value()) op.add(Log::Field::COUNT, count.value());
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 7) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 7) {
         throw ExecutionException("show finance error: privilege not enough to operate.");
     }
     LogManager::getInstance().markOperationSuccess(log_id);
@@ -20,7 +20,7 @@ void ShowFinanceCommand::execute(User::USERID_T& current_userid, int& current_bo
     }
 
     long long income = 0, expense = 0;
-    std::tie(income, expense) = log_mgr.getFinanceValue(count.value_or(0));
+    std::tie(income, expense) = log_mgr().getFinanceValue(count.value_or(0));
 
     os << "+ ";
     util::outputDecimal(os, income);
@@ -29,13 +29,11 @@ void ShowFinanceCommand::execute(User::USERID_T& current_userid, int& current_bo
     os << "\n";
 }
 ShowFinanceCommand::ShowFinanceCommand(int _count) : count(_count) {}
-void ReportFinanceCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                                   std::ostream& os) {
-    std::string command_str = "report finance";
+void ReportFinanceCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::REPORT_FINANCE);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 7) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 7) {
         throw ExecutionException("report finance error: privilege not enough to operate.");
     }
     LogManager::getInstance().markOperationSuccess(log_id);
@@ -44,9 +42,9 @@ void ReportFinanceCommand::execute(User::USERID_T& current_userid, int& current_
     util::printTableHead(os, length);
     util::printTableBody(os, length, {"Time", "UserID", "Finance Change"});
     util::printTableMiddle(os, length);
-    int count = log_mgr.getFinanceLogCount();
+    int count = log_mgr().getFinanceLogCount();
     for (int i = 1; i <= count; i++) {
-        FinanceLogEntry entry = log_mgr.getFinanceLogEntry(i);
+        FinanceLogEntry entry = log_mgr().getFinanceLogEntry(i);
         std::string time_str = util::timestampToString(entry.timestamp);
         std::string userid_str = util::toString(entry.userid);
         std::string value =
@@ -55,46 +53,48 @@ void ReportFinanceCommand::execute(User::USERID_T& current_userid, int& current_
     }
     util::printTableBottom(os, length);
 }
-void ReportEmployeeCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                                    std::ostream& os) {
-    std::string command_str = "report employee";
+void ReportEmployeeCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::REPORT_EMPLOYEE);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 7) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 7) {
         throw ExecutionException("report employee error: privilege not enough to operate.");
     }
     LogManager::getInstance().markOperationSuccess(log_id);
     const std::vector<int> length{20, 10, 40, 6};
-    auto pairs = log_mgr.getUserIdPairs();
-    for (int l = 0, r; l < pairs.size(); l = r + 1) {
-        for (r = l; r + 1 < pairs.size() && pairs[r + 1].first == pairs[l].first; r = r + 1);
-        // std::cerr << "userid = " << util::toString(pairs[l].first) << "\n";
-        OperationLogEntry entry_first = log_mgr.getOperationLogEntry(pairs[l].second);
-        if (entry_first.user_privilege < 3) continue;
-        os << "Employee Report of:" << util::toString(pairs[l].first) << "\n";
-
-        util::printTableHead(os, length);
-        util::printTableBody(os, length, {"Time", "UserID", "Operation", "Status"});
-        util::printTableMiddle(os, length);
-        for (int i = l; i <= r; i++) {
-            OperationLogEntry entry = log_mgr.getOperationLogEntry(pairs[i].second);
-            std::string time_str = util::timestampToString(entry.timestamp);
-            std::string userid_str = util::toString(entry.userid);
-            std::string operation_str = util::toString(entry.op);
-            std::string status_str = (entry.is_success) ? "Ok" : "Failed";
-            util::printTableBody(os, length, {time_str, userid_str, operation_str, status_str});
-        }
+    // the entries of a user come together, and are reported if the first one is by an employee
+    std::optional<User::USERID_T> current_userid_in_log;
+    bool reporting = false;
+    auto finishReport = [&] {
+        if (!reporting) return;
         util::printTableBottom(os, length);
         os << "\n";
-    }
+    };
+    log_mgr().forEachOperationLogByUser([&](const OperationLogEntry& entry) {
+        std::string userid_str = util::toString(entry.userid);
+        if (entry.userid != current_userid_in_log) {
+            finishReport();
+            current_userid_in_log = entry.userid;
+            reporting = entry.user_privilege >= 3;
+            if (!reporting) return;
+            os << "Employee Report of:" << userid_str << "\n";
+            util::printTableHead(os, length);
+            util::printTableBody(os, length, {"Time", "UserID", "Operation", "Status"});
+            util::printTableMiddle(os, length);
+        }
+        if (!reporting) return;
+        std::string time_str = util::timestampToString(entry.timestamp);
+        std::string operation_str = entry.op.toString();
+        std::string status_str = (entry.is_success) ? "Ok" : "Failed";
+        util::printTableBody(os, length, {time_str, userid_str, operation_str, status_str});
+    });
+    finishReport();
 }
-void LogCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str = "log";
+void LogCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::LOG);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 7) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 7) {
         throw ExecutionException("log error: privilege not enough to operate.");
     }
     LogManager::getInstance().markOperationSuccess(log_id);
@@ -103,12 +103,12 @@ void LogCommand::execute(User::USERID_T& current_userid, int& current_bookid, st
     util::printTableHead(os, length);
     util::printTableBody(os, length, {"Time", "UserID", "Operation", "Status"});
     util::printTableMiddle(os, length);
-    int count = log_mgr.getOperationLogCount();
+    int count = log_mgr().getOperationLogCount();
     for (int i = 1; i <= count; i++) {
-        OperationLogEntry entry = log_mgr.getOperationLogEntry(i);
+        OperationLogEntry entry = log_mgr().getOperationLogEntry(i);
         std::string time_str = util::timestampToString(entry.timestamp);
         std::string userid_str = util::toString(entry.userid);
-        std::string operation_str = util::toString(entry.op);
+        std::string operation_str = entry.op.toString();
         std::string status_str = (entry.is_success) ? "Ok" : "Failed";
         util::printTableBody(os, length, {time_str, userid_str, operation_str, status_str});
     }
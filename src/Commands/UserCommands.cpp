@@ -1,39 +1,38 @@
 #include "Commands/UserCommands.hpp"
 
+#include <utility>
+
 #include "Utils.hpp"
 
-void SwitchUserCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                                std::ostream& os) {
-    std::string command_str = "su -user=" + util::toString(userid);
-    if (password.has_value()) {
-        command_str = command_str + " -password=" + util::toString(password.value());
-    }
+void SwitchUserCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::SU);
+    op.add(Log::Field::USERID, util::toString(userid));
+    if (password.has_value()) op.add(Log::Field::PASSWORD, util::toString(password.value()));
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
 
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 0) {
+    if (ctx.privilege() < 0) {
         throw ExecutionException("su error: privilege not enough to operate.");
     }
 
-    if (!usr_mgr.useridExists(userid)) {
+    if (!usr_mgr().useridExists(userid)) {
         throw ExecutionException("su error: userID don't exists.");
     }
-    const User& user = usr_mgr.getUserByUserid(userid);
+    const User user = usr_mgr().getUserByUserid(userid);
     if (password == std::nullopt) {  // no password provided
         // FIXME(llx) ambiguous meaning of “高于”
-        if (usr_mgr.getUserByUserid(current_userid).privilege <= user.privilege) {
+        if (ctx.privilege() <= user.privilege) {
             throw ExecutionException("su error: privilege not enough to omit password.");
         }
     } else {
-        if (!usr_mgr.isPasswordCorrect(userid, password.value())) {
+        if (user.password != password.value()) {
             throw ExecutionException("su error: password incorrect.");
         }
     }
 
-    current_userid = userid;
-    current_bookid = 0;
-    usr_mgr.modifyLoginCount(current_userid, 1);
+    ctx.user = user;
+    ctx.selected_id = 0;
+    usr_mgr().modifyLoginCount(userid, 1);
 
     LogManager::getInstance().markOperationSuccess(log_id);
 }
@@ -42,30 +41,28 @@ SwitchUserCommand::SwitchUserCommand(const User::USERID_T& _userid,
                                      const User::PASSWORD_T& _password)
     : userid(_userid), password(_password) {}
 
-void LogoutCommand::execute(User::USERID_T& current_userid, int& current_bookid, std::ostream& os) {
-    std::string command_str = "logout";
+void LogoutCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::LOGOUT);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 1) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 1) {
         throw ExecutionException("logout error: privilege not enough to operate.");
     }
-    usr_mgr.modifyLoginCount(current_userid, -1);
+    usr_mgr().modifyLoginCount(ctx.userid(), -1);
     LogManager::getInstance().markOperationSuccess(log_id);
 }
 
-void RegisterCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                              std::ostream& os) {
-    std::string command_str =
-        "register -user=" + util::toString(userid) + " -username=" + util::toString(username);
+void RegisterCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::REGISTER);
+    op.add(Log::Field::USERID, util::toString(userid))
+        .add(Log::Field::USERNAME, util::toString(username));
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 0) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 0) {
         throw ExecutionException("register error: privilege not enough to operate.");
     }
 
-    if (usr_mgr.useridExists(userid)) {
+    if (usr_mgr().useridExists(userid)) {
         throw ExecutionException("register error: userid already exists.");
     }
     User user;
@@ -73,38 +70,37 @@ void RegisterCommand::execute(User::USERID_T& current_userid, int& current_booki
     user.username = username;
     user.password = password;
     user.privilege = 1;
-    usr_mgr.addUser(user);
+    usr_mgr().addUser(user);
     LogManager::getInstance().markOperationSuccess(log_id);
 }
 RegisterCommand::RegisterCommand(const User::USERID_T& _userid, const User::PASSWORD_T& _password,
                                  const User::USERNAME_T& _username)
     : userid(_userid), password(_password), username(_username) {}
 
-void ChangePasswordCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                                    std::ostream& os) {
-    std::string command_str = "passwd -user=" + util::toString(userid);
+void ChangePasswordCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::PASSWD);
+    op.add(Log::Field::USERID, util::toString(userid));
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
 
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 1) {
+    if (ctx.privilege() < 1) {
         throw ExecutionException("passwd error: privilege not enough to operate.");
     }
 
-    if (!usr_mgr.useridExists(userid)) {
+    if (!usr_mgr().useridExists(userid)) {
         throw ExecutionException("passwd error: userid doesn't exist.");
     }
     if (current_password == std::nullopt) {
-        if (usr_mgr.getUserByUserid(current_userid).privilege != 7) {
+        if (ctx.privilege() != 7) {
             throw ExecutionException(
                 "passwd error: privilege not enough to omit current password.");
         }
     } else {
-        if (!usr_mgr.isPasswordCorrect(userid, current_password.value())) {
+        if (!usr_mgr().isPasswordCorrect(userid, current_password.value())) {
             throw ExecutionException("passwd error: current password is incorrect.");
         }
     }
-    usr_mgr.modifyPassword(userid, new_password);
+    usr_mgr().modifyPassword(userid, new_password);
 
     LogManager::getInstance().markOperationSuccess(log_id);
 }
@@ -116,22 +112,21 @@ ChangePasswordCommand::ChangePasswordCommand(const User::USERID_T& _userid,
                                              const User::PASSWORD_T& _new_password)
     : userid(_userid), current_password(_current_password), new_password(_new_password) {}
 
-void AddUserCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                             std::ostream& os) {
-    std::string command_str = "useradd -user=" + util::toString(userid) +
-                              " -username=" + util::toString(username) +
-                              " -privilege=" + std::to_string(privilege);
+void AddUserCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::USERADD);
+    op.add(Log::Field::USERID, util::toString(userid))
+        .add(Log::Field::USERNAME, util::toString(username))
+        .add(Log::Field::PRIVILEGE, privilege);
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 3) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 3) {
         throw ExecutionException("useradd error: privilege not enough to operate.");
     }
 
-    if (usr_mgr.useridExists(userid)) {
+    if (usr_mgr().useridExists(userid)) {
         throw ExecutionException("useradd error: userid already exists.");
     }
-    if (privilege >= usr_mgr.getUserByUserid(current_userid).privilege) {
+    if (privilege >= ctx.privilege()) {
         throw ExecutionException("useradd error: cannot add user with same or higher privilege.");
     }
     User user;
@@ -139,7 +134,7 @@ void AddUserCommand::execute(User::USERID_T& current_userid, int& current_bookid
     user.username = username;
     user.password = password;
     user.privilege = privilege;
-    usr_mgr.addUser(user);
+    usr_mgr().addUser(user);
 
     LogManager::getInstance().markOperationSuccess(log_id);
 }
@@ -147,23 +142,22 @@ AddUserCommand::AddUserCommand(const User::USERID_T& _userid, const User::PASSWO
                                int _privilege, const User::USERNAME_T& _username)
     : userid(_userid), password(_password), privilege(_privilege), username(_username) {}
 
-void DeleteUserCommand::execute(User::USERID_T& current_userid, int& current_bookid,
-                                std::ostream& os) {
-    std::string command_str = "delete -user=" + util::toString(userid);
+void DeleteUserCommand::run(ExecutionContext& ctx, std::ostream& os) {
+    Log::Operation op(Log::OpCode::DELETE);
+    op.add(Log::Field::USERID, util::toString(userid));
     int log_id = LogManager::getInstance().addOperationLog(
-        util::getTimestamp(), current_userid, usr_mgr.getUserByUserid(current_userid).privilege,
-        util::toArray<Log::OPERATION_T>(command_str));
-    if (usr_mgr.getUserByUserid(current_userid).privilege < 7) {
+        util::getTimestamp(), ctx.userid(), ctx.privilege(), std::move(op));
+    if (ctx.privilege() < 7) {
         throw ExecutionException("delete error: privilege not enough to operate.");
     }
 
-    if (!usr_mgr.useridExists(userid)) {
+    if (!usr_mgr().useridExists(userid)) {
         throw ExecutionException("delete error: userid doesn't exist.");
     }
-    if (usr_mgr.getLoginCount(userid) > 0) {
+    if (usr_mgr().getLoginCount(userid) > 0) {
         throw ExecutionException("delete error: userid have been logged in");
     }
-    usr_mgr.eraseUser(userid);
+    usr_mgr().eraseUser(userid);
     LogManager::getInstance().markOperationSuccess(log_id);
 }
 DeleteUserCommand::DeleteUserCommand(const User::USERID_T& _userid) : userid(_userid) {}
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "LogManager.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <utility>
 
 #include "Utils.hpp"
 
@@ -9,14 +12,24 @@ LogManager& LogManager::getInstance() {
     return instance;
 }
 void LogManager::addFinanceLog(long long timestamp, User::USERID_T userid, long long value) {
+    std::lock_guard lock(finance_mutex);
     int log_count;
     finance_log.getInfo(log_count, 1);
     FinanceLogEntry entry{timestamp, userid, value};
     finance_log.write(entry);
     ++log_count;
     finance_log.writeInfo(log_count, 1);
+
+    if (value > 0) {
+        finance_total.income += value;
+    } else {
+        finance_total.expense -= value;
+    }
+    putFinanceTotal(log_count);
+    finance_totals.writeInfo(log_count, 1);
 }
 std::pair<long long, long long> LogManager::getFinanceValue(int cnt) {
+    std::lock_guard lock(finance_mutex);
     int log_count;
     finance_log.getInfo(log_count, 1);
     if (!cnt) cnt = log_count;
@@ -24,62 +37,163 @@ std::pair<long long, long long> LogManager::getFinanceValue(int cnt) {
     if (log_count < cnt) {
         throw std::out_of_range("cnt is too large");
     }
-    long long income = 0, expense = 0;
-    for (int i = log_count; i > log_count - cnt; i--) {
+    // the difference of two running totals
+    FinanceTotal before{};
+    if (log_count > cnt) finance_totals.read(before, log_count - cnt);
+    return std::make_pair(finance_total.income - before.income,
+                          finance_total.expense - before.expense);
+}
+void LogManager::rebuildFinanceTotals() {
+    std::lock_guard lock(finance_mutex);
+    int log_count, total_count;
+    finance_log.getInfo(log_count, 1);
+    finance_totals.getInfo(total_count, 1);
+    if (total_count > log_count) total_count = 0;  // inconsistent, rebuild everything
+    // files written before the totals were appended have no allocated slots, and are rebuilt
+    total_count = std::min(total_count, finance_totals.getCount());
+    finance_total = {};
+    if (total_count) finance_totals.read(finance_total, total_count);
+    for (int i = total_count + 1; i <= log_count; i++) {
         FinanceLogEntry entry;
         finance_log.read(entry, i);
-        long long value = entry.value;
-        if (value > 0) {
-            income += value;
+        if (entry.value > 0) {
+            finance_total.income += entry.value;
         } else {
-            expense -= value;
+            finance_total.expense -= entry.value;
         }
+        putFinanceTotal(i);
+    }
+    finance_totals.writeInfo(log_count, 1);
+}
+void LogManager::putFinanceTotal(int i) {
+    // the slots past the valid totals are left by a crash between the two writes, and are reused
+    if (i <= finance_totals.getCount()) {
+        finance_totals.update(finance_total, i);
+    } else {
+        [[maybe_unused]] const int index = finance_totals.write(finance_total);
+        assert(index == i);
     }
-    return std::make_pair(income, expense);
 }
 int LogManager::addOperationLog(long long timestamp, User::USERID_T userid, int privilege,
-                                Log::OPERATION_T op) {
-    int log_count;
-    operation_log.getInfo(log_count, 1);
-    OperationLogEntry entry{timestamp, userid, privilege, op, 0};
-    ++log_count;
-    operation_log.writeInfo(log_count, 1);
-
-    int id = operation_log.write(entry);
-    if (util::toString(userid) != "<GUEST>") user_index.insert(userid, id);
+                                Log::Operation op) {
+    OperationLogEntry entry{timestamp, userid, privilege, std::move(op), 0};
+    std::unique_lock lock(buffer_mutex);
+    if (!writer.joinable()) {
+        // the entry is written under the lock, so that the entries are appended in the order of id
+        const int id = ++log_count;
+        taken_count = written_count = log_count;
+        writeOperationLogs(&entry, id, 1);
+        return id;
+    }
+    buffer_cv.wait(lock, [this] { return log_count - taken_count < LOG_BUFFER_SIZE; });
+    const int id = ++log_count;
+    log_buffer[id % LOG_BUFFER_SIZE] = std::move(entry);
+    buffer_cv.notify_all();
     return id;
 }
 void LogManager::markOperationSuccess(int id) {
-    OperationLogEntry entry;
-    operation_log.read(entry, id);
-    entry.is_success = 1;
-    operation_log.update(entry, id);
+    {
+        std::unique_lock lock(buffer_mutex);
+        if (id > taken_count) {  // still in the buffer
+            log_buffer[id % LOG_BUFFER_SIZE].is_success = 1;
+            return;
+        }
+        // don't let the writer overwrite the flag with the entry being written
+        buffer_cv.wait(lock, [this, id] { return written_count >= id; });
+    }
+    std::lock_guard io_lock(io_mutex);
+    operation_log.markSuccess(id);
+}
+void LogManager::setAsyncOperationLog(bool enabled) {
+    if (enabled == writer.joinable()) return;
+    if (enabled) {
+        log_buffer.resize(LOG_BUFFER_SIZE);
+        stopping = false;
+        writer = std::thread(&LogManager::runOperationLogWriter, this);
+    } else {
+        {
+            std::lock_guard lock(buffer_mutex);
+            stopping = true;
+        }
+        buffer_cv.notify_all();
+        writer.join();
+        log_buffer.clear();
+        log_buffer.shrink_to_fit();
+    }
+}
+void LogManager::flushOperationLog() {
+    std::unique_lock lock(buffer_mutex);
+    const int target = log_count;
+    if (written_count >= target) return;
+    ++flush_waiters;
+    buffer_cv.notify_all();
+    buffer_cv.wait(lock, [this, target] { return written_count >= target; });
+    --flush_waiters;
 }
 int LogManager::getFinanceLogCount() {
+    std::lock_guard lock(finance_mutex);
     int count = 0;
     finance_log.getInfo(count, 1);
     return count;
 }
 FinanceLogEntry LogManager::getFinanceLogEntry(int id) {
+    std::lock_guard lock(finance_mutex);
     FinanceLogEntry entry;
     finance_log.read(entry, id);
     return entry;
 }
 int LogManager::getOperationLogCount() {
-    int count = 0;
-    operation_log.getInfo(count, 1);
-    return count;
+    flushOperationLog();
+    std::lock_guard io_lock(io_mutex);
+    return operation_log.size();
 }
 OperationLogEntry LogManager::getOperationLogEntry(int id) {
-    OperationLogEntry entry;
-    operation_log.read(entry, id);
-    return entry;
+    flushOperationLog();
+    std::lock_guard io_lock(io_mutex);
+    return operation_log.read(id);
 }
-std::vector<std::pair<User::USERID_T, int>> LogManager::getUserIdPairs() {
-    return user_index.queryAllKeyValuePairs();
+void LogManager::runOperationLogWriter() {
+    std::unique_lock lock(buffer_mutex);
+    while (true) {
+        buffer_cv.wait(lock, [this] { return stopping || log_count > taken_count; });
+        if (log_count == taken_count) return;  // stopping, and everything is written
+        buffer_cv.wait_for(lock, GROUP_COMMIT_DELAY, [this] {
+            return stopping || flush_waiters || log_count - taken_count >= LOG_BUFFER_SIZE / 2;
+        });
+        const int first_id = taken_count + 1;
+        std::vector<OperationLogEntry> batch;
+        for (int id = first_id; id <= log_count; id++) {
+            batch.push_back(std::move(log_buffer[id % LOG_BUFFER_SIZE]));
+        }
+        taken_count = log_count;
+        buffer_cv.notify_all();  // wake up the producers waiting for space
+        lock.unlock();
+        writeOperationLogs(batch.data(), first_id, batch.size());
+        lock.lock();
+        written_count = first_id + batch.size() - 1;
+        buffer_cv.notify_all();
+    }
+}
+void LogManager::writeOperationLogs(const OperationLogEntry* entries, int first_id, int n) {
+    std::lock_guard io_lock(io_mutex);
+    assert(first_id == operation_log.size() + 1);
+    operation_log.append(entries, n);
+    for (int i = 0; i < n; i++) {
+        if (util::toString(entries[i].userid) != "<GUEST>") {
+            user_index.insert(entries[i].userid, first_id + i);
+        }
+    }
 }
 LogManager::LogManager() {
     finance_log.initialise("log_finance");
-    operation_log.initialise("log_operation");
+    finance_totals.initialise("log_finance_total");
+    operation_log.open("log_operation", "log_operation_index");
     user_index.initialise("log_user_index");
-}
\ No newline at end of file
+    finance_log.setCacheCapacity(CACHE_SIZE);
+    operation_log.setCacheCapacity(CACHE_SIZE);
+    log_count = operation_log.size();
+    taken_count = written_count = log_count;
+    // also covers log files written before the totals existed
+    rebuildFinanceTotals();
+}
+LogManager::~LogManager() { setAsyncOperationLog(false); }
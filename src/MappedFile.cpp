@@ -0,0 +1,134 @@
+#include "MappedFile.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+
+MappedFile::~MappedFile() { close(); }
+
+void MappedFile::open(const std::string& file_name) {
+    fd = ::open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + file_name);
+    }
+    struct stat st {};
+    fstat(fd, &st);
+    file_size = st.st_size;
+    mapped_size = 0;
+    reserve(file_size);
+    if (auto& log = WriteAheadLog::getInstance(); log.isOpen()) {
+        wal = log.attach(
+            file_name,
+            {[this](char* dst, long long pos, size_t len) { readDirect(dst, pos, len); },
+             [this](const char* src, long long pos, size_t len) { writeDirect(src, pos, len); },
+             [this] { sync(); }});
+    }
+}
+void MappedFile::close() {
+    if (fd < 0) return;
+    if (wal) {
+        wal->close();
+        wal.reset();
+    }
+    if (base) munmap(base, mapped_size);
+    // drop the unused tail of the last chunk; failing to do so only wastes some disk space
+    [[maybe_unused]] int ret = ftruncate(fd, file_size.load());
+    ::close(fd);
+    fd = -1;
+    base = nullptr;
+    file_size = mapped_size = 0;
+}
+void MappedFile::read(char* dst, long long pos, size_t len) {
+    assert(fd >= 0);
+    if (pos < 0) {  // behaves like a failed seek
+        std::fill(dst, dst + len, 0);
+        return;
+    }
+    if (wal) {
+        wal->read(dst, pos, len);
+        return;
+    }
+    readDirect(dst, pos, len);
+}
+void MappedFile::write(const char* src, long long pos, size_t len) {
+    assert(fd >= 0);
+    if (pos < 0) return;  // behaves like a failed seek
+    if (wal) {
+        wal->write(src, pos, len);
+        return;
+    }
+    writeDirect(src, pos, len);
+}
+void MappedFile::flush() {
+    std::shared_lock lock(remap_mutex);
+    if (base) msync(base, mapped_size, MS_ASYNC);
+}
+void MappedFile::sync() {
+    {
+        std::shared_lock lock(remap_mutex);
+        if (base) msync(base, mapped_size, MS_SYNC);
+    }
+#ifdef __linux__
+    fdatasync(fd);
+#else
+    fsync(fd);
+#endif
+}
+
+void MappedFile::readDirect(char* dst, long long pos, size_t len) {
+    const long long size = file_size;
+    const size_t available = pos < size ? std::min<long long>(len, size - pos) : 0;
+    std::shared_lock lock(remap_mutex);
+    if (available) std::memcpy(dst, base + pos, available);
+    std::fill(dst + available, dst + len, 0);
+}
+void MappedFile::writeDirect(const char* src, long long pos, size_t len) {
+    const long long end = pos + static_cast<long long>(len);
+    std::shared_lock lock(remap_mutex);
+    if (end > mapped_size) {
+        lock.unlock();
+        {
+            std::unique_lock grow_lock(remap_mutex);
+            reserve(end);
+        }
+        lock.lock();
+    }
+    std::memcpy(base + pos, src, len);
+    long long size = file_size;
+    while (size < end && !file_size.compare_exchange_weak(size, end)) {
+    }
+}
+void MappedFile::reserve(long long size) {
+    const long long new_size =
+        std::max(GROW_CHUNK, (size + GROW_CHUNK - 1) / GROW_CHUNK * GROW_CHUNK);
+    if (new_size <= mapped_size) return;
+    if (ftruncate(fd, new_size) != 0) {
+        throw std::runtime_error("ftruncate failed");
+    }
+    void* ptr;
+#ifdef __linux__
+    if (base) {
+        ptr = mremap(base, mapped_size, new_size, MREMAP_MAYMOVE);
+    } else {
+        ptr = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+#else
+    if (base) munmap(base, mapped_size);
+    ptr = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#endif
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("mmap failed");
+    }
+    base = static_cast<char*>(ptr);
+    mapped_size = new_size;
+}
+#endif
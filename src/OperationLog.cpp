@@ -0,0 +1,175 @@
+#include "OperationLog.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace Log {
+namespace {
+// indexed by OpCode and Field
+constexpr std::array<const char*, 16> OPCODE_NAMES{
+    "", "su", "logout", "register", "passwd", "useradd", "delete", "show", "buy", "select",
+    "modify", "import", "show finance", "report finance", "report employee", "log"};
+constexpr std::array<const char*, 23> FIELD_NAMES{
+    "", "user", "password", "username", "privilege", "ISBN", "name", "author", "keyword",
+    "price", "quantity", "total_cost", "count", "any_keyword", "exclude_keyword",
+    "name_contains", "author_contains", "min_price", "max_price", "min_quantity", "max_quantity",
+    "cursor", "limit"};
+bool isInteger(Field field) {
+    return field == Field::PRIVILEGE || field == Field::PRICE || field == Field::QUANTITY ||
+           field == Field::TOTAL_COST || field == Field::COUNT ||
+           (field >= Field::MIN_PRICE && field <= Field::MAX_QUANTITY) || field == Field::LIMIT;
+}
+long long decodeInteger(const std::string& bytes) {
+    unsigned long long zigzag = 0;
+    for (size_t i = 0; i < bytes.size(); i++) {
+        zigzag |= static_cast<unsigned long long>(bytes[i] & 0x7f) << (7 * i);
+    }
+    return static_cast<long long>(zigzag >> 1) ^ -static_cast<long long>(zigzag & 1);
+}
+}  // namespace
+
+Operation::Operation(OpCode code) : bytes(1, static_cast<char>(code)) {}
+Operation& Operation::add(Field field, const std::string& value) {
+    if (value.size() > 255) throw std::length_error("Operation argument is too long");
+    bytes.push_back(static_cast<char>(field));
+    bytes.push_back(static_cast<char>(value.size()));
+    bytes += value;
+    return *this;
+}
+Operation& Operation::add(Field field, long long value) {
+    auto zigzag = (static_cast<unsigned long long>(value) << 1) ^
+                  static_cast<unsigned long long>(value >> 63);
+    std::string varint;
+    do {
+        varint.push_back(static_cast<char>((zigzag & 0x7f) | (zigzag >= 0x80 ? 0x80 : 0)));
+        zigzag >>= 7;
+    } while (zigzag);
+    return add(field, varint);
+}
+std::string Operation::toString() const {
+    if (bytes.empty()) return "";
+    // a LEGACY operation has an empty name and a single TEXT argument
+    const auto code = static_cast<OpCode>(bytes[0]);
+    std::string result = OPCODE_NAMES.at(static_cast<size_t>(code));
+    for (size_t pos = 1; pos + 1 < bytes.size();) {
+        const auto field = static_cast<Field>(bytes[pos]);
+        const size_t length = static_cast<unsigned char>(bytes[pos + 1]);
+        const std::string value = bytes.substr(pos + 2, length);
+        pos += 2 + length;
+        if (field == Field::TEXT) {
+            result += value;
+            continue;
+        }
+        result += std::string(" -") + FIELD_NAMES.at(static_cast<size_t>(field)) + "=";
+        result += isInteger(field) ? std::to_string(decodeInteger(value)) : value;
+    }
+    return result;
+}
+Operation Operation::fromData(std::string data) {
+    Operation op;
+    op.bytes = std::move(data);
+    return op;
+}
+}  // namespace Log
+
+void OperationLogFile::open(const std::string& file_name, const std::string& index_file_name) {
+    file.open(file_name);
+    index.initialise(index_file_name);
+    index.getInfo(count, 1);
+    cursor_id = 0;
+    // the offsets missing from the index, as in files written before its entries were appended,
+    // are recovered by skipping the records after the last one indexed
+    const int indexed = std::min(index.getCount(), count ? (count - 1) / INDEX_STRIDE + 1 : 0);
+    int id = 0;  // the last record skipped, which ends at offset
+    long long offset = 0;
+    if (indexed) {
+        id = (indexed - 1) * INDEX_STRIDE + 1;
+        index.read(offset, indexed);
+        offset += recordLength(offset);
+    }
+    for (; id < count; id++) {
+        if (id % INDEX_STRIDE == 0) putOffset(id + 1, offset);
+        offset += recordLength(offset);
+    }
+    end_offset = offset;
+}
+void OperationLogFile::append(const OperationLogEntry* entries, int n) {
+    std::string records;
+    for (int i = 0; i < n; i++) {
+        const OperationLogEntry& entry = entries[i];
+        const int id = count + i + 1;
+        if ((id - 1) % INDEX_STRIDE == 0) {
+            putOffset(id, end_offset + static_cast<long long>(records.size()));
+        }
+        const size_t userid_length = strnlen(entry.userid.data(), entry.userid.size());
+        const auto length =
+            static_cast<uint16_t>(USERID_OFFSET + 1 + userid_length + entry.op.data().size());
+        const long long timestamp = entry.timestamp;
+        records.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        records.push_back(static_cast<char>(entry.is_success));
+        records.push_back(static_cast<char>(entry.user_privilege));
+        records.append(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
+        records.push_back(static_cast<char>(userid_length));
+        records.append(entry.userid.data(), userid_length);
+        records += entry.op.data();
+    }
+    file.write(records.data(), end_offset, records.size());
+    end_offset += static_cast<long long>(records.size());
+    count += n;
+    index.writeInfo(count, 1);
+}
+OperationLogEntry OperationLogFile::read(int id) {
+    assert(1 <= id && id <= count);
+    const long long offset = locate(id);
+    std::string record(recordLength(offset), '\0');
+    file.read(record.data(), offset, record.size());
+
+    OperationLogEntry entry{};
+    entry.is_success = record[SUCCESS_OFFSET];
+    entry.user_privilege = static_cast<signed char>(record[PRIVILEGE_OFFSET]);
+    std::memcpy(&entry.timestamp, record.data() + TIMESTAMP_OFFSET, sizeof(entry.timestamp));
+    const size_t userid_length = static_cast<unsigned char>(record[USERID_OFFSET]);
+    std::memcpy(entry.userid.data(), record.data() + USERID_OFFSET + 1, userid_length);
+    entry.op = Log::Operation::fromData(record.substr(USERID_OFFSET + 1 + userid_length));
+    return entry;
+}
+void OperationLogFile::markSuccess(int id) {
+    assert(1 <= id && id <= count);
+    const char flag = 1;
+    file.write(&flag, locate(id) + SUCCESS_OFFSET, 1);
+}
+
+long long OperationLogFile::locate(int id) {
+    if (id == count + 1) return end_offset;
+    int from_id = (id - 1) / INDEX_STRIDE * INDEX_STRIDE + 1;
+    long long offset;
+    if (from_id <= cursor_id && cursor_id <= id) {
+        from_id = cursor_id;
+        offset = cursor_offset;
+    } else {
+        index.read(offset, (id - 1) / INDEX_STRIDE + 1);
+    }
+    for (; from_id < id; from_id++) offset += recordLength(offset);
+    cursor_id = id;
+    cursor_offset = offset;
+    return offset;
+}
+void OperationLogFile::putOffset(int id, long long offset) {
+    const int k = (id - 1) / INDEX_STRIDE + 1;
+    // the entries past the records are left by a crash before the records were counted
+    if (k <= index.getCount()) {
+        index.update(offset, k);
+    } else {
+        [[maybe_unused]] const int allocated = index.write(offset);
+        assert(allocated == k);
+    }
+}
+int OperationLogFile::recordLength(long long offset) {
+    uint16_t length;
+    file.read(reinterpret_cast<char*>(&length), offset, sizeof(length));
+    return length;
+}
@@ -0,0 +1,215 @@
+#include "PagedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+
+namespace {
+// There is no positional I/O on Windows, so the seek and the transfer are done under a lock.
+std::mutex seek_mutex;
+long long pread(int fd, void* buf, size_t len, long long pos) {
+    std::lock_guard lock(seek_mutex);
+    _lseeki64(fd, pos, SEEK_SET);
+    return _read(fd, buf, static_cast<unsigned>(len));
+}
+long long pwrite(int fd, const void* buf, size_t len, long long pos) {
+    std::lock_guard lock(seek_mutex);
+    _lseeki64(fd, pos, SEEK_SET);
+    return _write(fd, buf, static_cast<unsigned>(len));
+}
+}  // namespace
+#else
+#include <unistd.h>
+#endif
+
+PagedFile::~PagedFile() { close(); }
+
+void PagedFile::open(const std::string& file_name) {
+#ifdef _WIN32
+    fd = ::_open(file_name.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + file_name);
+    }
+    struct stat st {};
+    fstat(fd, &st);
+    file_size = st.st_size;
+    if (auto& log = WriteAheadLog::getInstance(); log.isOpen()) {
+        wal = log.attach(
+            file_name,
+            {[this](char* dst, long long pos, size_t len) { readDirect(dst, pos, len); },
+             [this](const char* src, long long pos, size_t len) { writeDirect(src, pos, len); },
+             [this] { sync(); }});
+    }
+}
+void PagedFile::close() {
+    if (fd < 0) return;
+    if (wal) {
+        wal->close();
+        wal.reset();
+    }
+    flush();
+    lru.clear();
+    page_table.clear();
+    ::close(fd);
+    fd = -1;
+}
+void PagedFile::read(char* dst, long long pos, size_t len) {
+    assert(fd >= 0);
+    if (pos < 0) {  // behaves like a failed seek
+        std::fill(dst, dst + len, 0);
+        return;
+    }
+    if (wal) {
+        wal->read(dst, pos, len);
+        return;
+    }
+    readDirect(dst, pos, len);
+}
+void PagedFile::write(const char* src, long long pos, size_t len) {
+    assert(fd >= 0);
+    if (pos < 0) return;  // behaves like a failed seek
+    if (wal) {
+        wal->write(src, pos, len);
+        return;
+    }
+    writeDirect(src, pos, len);
+}
+void PagedFile::flush() {
+    std::lock_guard lock(cache_mutex);
+    for (auto& page : lru) {
+        if (page.dirty) writeBack(page);
+    }
+}
+void PagedFile::sync() {
+    flush();
+#ifdef _WIN32
+    _commit(fd);
+#elif defined(__linux__)
+    fdatasync(fd);
+#else
+    fsync(fd);
+#endif
+}
+void PagedFile::truncate(long long size) {
+    flush();
+    {
+        std::lock_guard lock(cache_mutex);
+        lru.clear();
+        page_table.clear();
+    }
+#ifdef _WIN32
+    const int ret = _chsize_s(fd, size);
+#else
+    const int ret = ftruncate(fd, size);
+#endif
+    if (ret != 0) {
+        throw std::runtime_error("truncate failed");
+    }
+    file_size = size;
+}
+void PagedFile::setCacheCapacity(size_t bytes) {
+    std::lock_guard lock(cache_mutex);
+    max_pages = bytes / PAGE_SIZE;
+    evict(0);
+}
+
+void PagedFile::readDirect(char* dst, long long pos, size_t len) {
+    if (!max_pages) {
+        readFromFile(dst, pos, len);
+        return;
+    }
+    std::lock_guard lock(cache_mutex);
+    while (len) {
+        const size_t in_page = pos % PAGE_SIZE;
+        const size_t n = std::min(len, PAGE_SIZE - in_page);
+        const Page& page = fetchPage(pos / PAGE_SIZE, false);
+        std::memcpy(dst, page.data.data() + in_page, n);
+        dst += n;
+        pos += n;
+        len -= n;
+    }
+}
+void PagedFile::writeDirect(const char* src, long long pos, size_t len) {
+    if (!max_pages) {
+        writeToFile(src, pos, len);
+        extendTo(pos + static_cast<long long>(len));
+        return;
+    }
+    std::lock_guard lock(cache_mutex);
+    while (len) {
+        const size_t in_page = pos % PAGE_SIZE;
+        const size_t n = std::min(len, PAGE_SIZE - in_page);
+        Page& page = fetchPage(pos / PAGE_SIZE, n == PAGE_SIZE);
+        std::memcpy(page.data.data() + in_page, src, n);
+        page.dirty = true;
+        src += n;
+        pos += n;
+        len -= n;
+        extendTo(pos);
+    }
+}
+
+PagedFile::Page& PagedFile::fetchPage(long long page_no, bool overwrite) {
+    if (auto it = page_table.find(page_no); it != page_table.end()) {
+        ++hits;
+        lru.splice(lru.begin(), lru, it->second);
+        return lru.front();
+    }
+    ++misses;
+    evict(1);
+    lru.push_front(Page{page_no, false, std::vector<char>(PAGE_SIZE)});
+    page_table[page_no] = lru.begin();
+    if (!overwrite) readFromFile(lru.front().data.data(), page_no * PAGE_SIZE, PAGE_SIZE);
+    return lru.front();
+}
+void PagedFile::evict(size_t reserve) {
+    while (!lru.empty() && lru.size() + reserve > max_pages) {
+        if (lru.back().dirty) writeBack(lru.back());
+        page_table.erase(lru.back().page_no);
+        lru.pop_back();
+    }
+}
+void PagedFile::writeBack(Page& page) {
+    const long long start = page.page_no * PAGE_SIZE;
+    // don't extend the file with the zero padding after the end of file
+    const long long len = std::min<long long>(PAGE_SIZE, file_size - start);
+    if (len > 0) writeToFile(page.data.data(), start, len);
+    page.dirty = false;
+}
+void PagedFile::readFromFile(char* dst, long long pos, size_t len) {
+    const size_t available = pos < file_size ? std::min<long long>(len, file_size - pos) : 0;
+    size_t got = 0;
+    // the tail may not be written back yet, which is a hole of zeroes
+    while (got < available) {
+        const long long n = pread(fd, dst + got, available - got, pos + got);
+        if (n <= 0) break;
+        got += n;
+    }
+    std::fill(dst + got, dst + len, 0);
+}
+void PagedFile::writeToFile(const char* src, long long pos, size_t len) {
+    while (len) {
+        const long long n = pwrite(fd, src, len, pos);
+        if (n < 0) {
+            throw std::runtime_error("write failed");
+        }
+        src += n;
+        pos += n;
+        len -= n;
+    }
+}
+void PagedFile::extendTo(long long end) {
+    long long size = file_size.load();
+    while (size < end && !file_size.compare_exchange_weak(size, end)) {
+    }
+}
@@ -111,7 +111,7 @@ auto handleSHOW(const std::vector<std::string>& tokens) -> std::unique_ptr<Comma
             result->author = util::toArray<Book::AUTHOR_T>(val);
         } else if (tp == Option::KEYWORD) {
             expect(val).consistedOf(PRINTABLE_WITHOUT_BAR);
-            result->keyword = util::toArray<Book::KEYWORD_T>(val);
+            result->keywords.push_back(util::toArray<Book::KEYWORD_T>(val));
         } else {
             throw ParseException("show error: invalid option");
         }
@@ -31,6 +31,13 @@ int parseQuantity(const std::string& token) {
     expect(value).ge(1).le(std::numeric_limits<int>::max());
     return value;
 }
+int parseStockLevel(const std::string& token) {
+    expect(token.empty()).Not().toBe(true);
+    expect(token).consistedOf(NUMERIC);
+    int value = util::toInt(token);
+    expect(value).ge(0).le(std::numeric_limits<int>::max());
+    return value;
+}
 long long parsePrice(const std::string& token) {
     expect(token.empty()).Not().toBe(true);
     expect(token).consistedOf(NUMERIC_DOT);
@@ -0,0 +1,34 @@
+#include "SnapshotMap.hpp"
+
+#include <limits>
+#include <thread>
+
+EpochReclaimer::~EpochReclaimer() {
+    for (auto& r : retired) r.free();
+}
+EpochReclaimer::Guard EpochReclaimer::pin() {
+    // start from a slot chosen by the thread, so that the readers rarely try the same slots
+    size_t i = std::hash<std::thread::id>{}(std::this_thread::get_id()) % MAX_READERS;
+    for (;; i = (i + 1) % MAX_READERS) {
+        // An epoch read before it advances is fine: a reader pinned at an older epoch only keeps
+        // more objects alive, and the replaced pointers were already swapped before the advance.
+        uint64_t expected = 0;
+        if (slots[i].compare_exchange_strong(expected, epoch.load())) return Guard(slots[i]);
+        if (i == MAX_READERS - 1) std::this_thread::yield();
+    }
+}
+void EpochReclaimer::retire(std::function<void()> free) {
+    retired.push_back({epoch.load(), std::move(free)});
+}
+void EpochReclaimer::advance() {
+    epoch.fetch_add(1);
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const auto& slot : slots) {
+        if (const uint64_t pinned = slot.load()) oldest = std::min(oldest, pinned);
+    }
+    // an object retired in an epoch can only be seen by the readers pinned at it or before it
+    while (!retired.empty() && retired.front().epoch < oldest) {
+        retired.front().free();
+        retired.pop_front();
+    }
+}
@@ -1,5 +1,8 @@
 #include "UsersManager.hpp"
 
+#include <mutex>
+#include <shared_mutex>
+
 #include "Utils.hpp"
 
 UsersManager& UsersManager::getInstance() {
@@ -7,53 +10,74 @@ UsersManager& UsersManager::getInstance() {
     return instance;
 }
 int UsersManager::getLoginCount(const User::USERID_T& userid) {
-    return getUserByUserid(userid).login_count;
+    std::shared_lock lock(mutex);
+    int login_count;
+    user_data.read(login_count, getIdByUserid(userid), offsetof(User, login_count));
+    return login_count;
 }
 void UsersManager::modifyLoginCount(const User::USERID_T& userid, int k) {
-    // XXX(llx) space of performance improvement here.
-    User user = getUserByUserid(userid);
-    user.login_count += k;
-    eraseUser(userid);
-    addUser(user);
+    std::unique_lock lock(mutex);
+    const int id = getIdByUserid(userid);
+    int login_count;
+    user_data.read(login_count, id, offsetof(User, login_count));
+    user_data.update(login_count + k, id, offsetof(User, login_count));
 }
 bool UsersManager::useridExists(const User::USERID_T& userid) {
-    return !user_data.query(userid).empty();
+    std::shared_lock lock(mutex);
+    return userid_index.contains(userid);
 }
 User UsersManager::getUserByUserid(const User::USERID_T& userid) {
-    auto result = user_data.query(userid);
-    if (result.empty()) {
-        throw std::runtime_error{"User does not exist"};
-    }
-    return result[0];
+    std::shared_lock lock(mutex);
+    User user;
+    user_data.read(user, getIdByUserid(userid));
+    return user;
 }
 bool UsersManager::isPasswordCorrect(const User::USERID_T& userid,
                                      const User::PASSWORD_T& password) {
-    return getUserByUserid(userid).password == password;
+    std::shared_lock lock(mutex);
+    User::PASSWORD_T password_now;
+    user_data.read(password_now, getIdByUserid(userid), offsetof(User, password));
+    return password_now == password;
 }
 void UsersManager::modifyPassword(const User::USERID_T& userid,
                                   const User::PASSWORD_T& new_password) {
-    User user = getUserByUserid(userid);
-    user.password = new_password;
-    eraseUser(userid);
-    addUser(user);
+    std::unique_lock lock(mutex);
+    user_data.update(new_password, getIdByUserid(userid), offsetof(User, password));
+}
+void UsersManager::addUser(const User& user) {
+    std::unique_lock lock(mutex);
+    if (userid_index.contains(user.userid)) return;
+    userid_index.insert(user.userid, user_data.write(user));
 }
-void UsersManager::addUser(const User& user) { user_data.insert(user.userid, user); }
 void UsersManager::eraseUser(const User::USERID_T& userid) {
-    auto result = user_data.query(userid);
-    assert(result.size() <= 1);
-    if (!result.empty()) {
-        user_data.erase(userid, result[0]);
-    }
+    std::unique_lock lock(mutex);
+    auto id = userid_index.find(userid);
+    if (!id) return;
+    userid_index.erase(userid);
+    user_data.erase(*id);
 }
 void UsersManager::reset() {
     this->~UsersManager();
     std::filesystem::remove("user_data");
+    std::filesystem::remove("user_userid_index");
     new (this) UsersManager();
 }
+int UsersManager::getIdByUserid(const User::USERID_T& userid) {
+    auto id = userid_index.find(userid);
+    if (!id) {
+        throw std::runtime_error{"User does not exist"};
+    }
+    return *id;
+}
 
 UsersManager::UsersManager() {
     user_data.initialise("user_data");
-    if (user_data.query(util::toArray<User::USERID_T>("root")).empty()) {
+    int magic;
+    user_data.getInfo(magic, 1);
+    // only a new file is marked, so that a file of an older format is still found by migrate_index
+    if (magic != USER_DATA_MAGIC && !user_data.getCount()) user_data.writeInfo(USER_DATA_MAGIC, 1);
+    userid_index.initialise("user_userid_index");
+    if (!useridExists(util::toArray<User::USERID_T>("root"))) {
         User root_user;
         root_user.userid = util::toArray<User::USERID_T>("root");
         root_user.username = util::toArray<User::USERNAME_T>("root");
@@ -61,7 +85,7 @@ UsersManager::UsersManager() {
         root_user.privilege = 7;
         addUser(root_user);
     }
-    if (user_data.query(util::toArray<User::USERID_T>("<GUEST>")).empty()) {
+    if (!useridExists(util::toArray<User::USERID_T>("<GUEST>"))) {
         User guest_user;
         guest_user.userid = util::toArray<User::USERID_T>("<GUEST>");
         guest_user.privilege = 0;
@@ -0,0 +1,301 @@
+#include "WriteAheadLog.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+#include "PagedFile.hpp"
+
+namespace {
+// FNV-1a
+uint64_t checksum(std::string_view bytes) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char c : bytes) h = (h ^ c) * 1099511628211ULL;
+    return h;
+}
+template <class T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+// Reads a T at pos of bytes, and moves pos past it. Returns false if bytes ends before it.
+template <class T>
+bool get(std::string_view bytes, size_t& pos, T& value) {
+    if (bytes.size() - pos < sizeof(T)) return false;
+    std::memcpy(&value, bytes.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+}  // namespace
+
+thread_local int WriteAheadLog::transaction_depth = 0;
+thread_local uint64_t WriteAheadLog::transaction_epoch = 0;
+
+WriteAheadLog& WriteAheadLog::getInstance() {
+    static WriteAheadLog instance;
+    return instance;
+}
+WriteAheadLog::~WriteAheadLog() { close(); }
+
+size_t WriteAheadLog::open(const std::string& path, Durability _durability) {
+    if (running) return 0;
+    durability = _durability;
+    file = std::make_unique<PagedFile>();
+    file->open(path);
+    const size_t replayed = recover();
+    log_size = 0;
+    current = {};
+    epoch = 1;
+    durable_epoch = applied_epoch = requested_epoch = 0;
+    stopping = false;
+    running = true;
+    committer = std::thread(&WriteAheadLog::runCommitter, this);
+    return replayed;
+}
+void WriteAheadLog::close() {
+    if (!running) return;
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    committer.join();
+    checkpoint();
+    {
+        std::lock_guard lock(files_mutex);
+        for (FileLog* f : files) {
+            std::unique_lock file_lock(f->mutex);
+            f->detached = true;
+        }
+        files.clear();
+    }
+    running = false;
+    file.reset();
+}
+void WriteAheadLog::flush() {
+    if (!running) return;
+    uint64_t target;
+    {
+        std::lock_guard lock(mutex);
+        target = epoch;
+    }
+    waitFor(target, true);
+}
+std::unique_ptr<WriteAheadLog::FileLog> WriteAheadLog::attach(const std::string& name,
+                                                              FileLog::Backend backend) {
+    auto f = std::make_unique<FileLog>(*this, name, std::move(backend));
+    std::lock_guard lock(files_mutex);
+    files.push_back(f.get());
+    return f;
+}
+
+WriteAheadLog::Transaction::Transaction() {
+    auto& log = getInstance();
+    if (transaction_depth++ || !log.isOpen()) return;
+    log.gate.lock_shared();
+    outermost = true;
+}
+WriteAheadLog::Transaction::~Transaction() {
+    --transaction_depth;
+    if (!outermost) return;
+    auto& log = getInstance();
+    log.gate.unlock_shared();
+    // the writes are visible to the others already, and only wait to become durable
+    if (transaction_epoch && log.durability == Durability::SYNC) {
+        log.waitFor(transaction_epoch, false);
+    }
+    transaction_epoch = 0;
+}
+
+void WriteAheadLog::FileLog::read(char* dst, long long pos, size_t len) {
+    std::shared_lock lock(mutex);
+    backend.read(dst, pos, len);
+    if (pages.empty()) return;
+    const long long last = pos + static_cast<long long>(len);
+    for (long long page_no = pos / PAGE_SIZE; page_no * PAGE_SIZE < last; ++page_no) {
+        const auto it = pages.find(page_no);
+        if (it == pages.end()) continue;
+        const long long start = page_no * PAGE_SIZE;
+        const long long from = std::max(pos, start), to = std::min(last, start + PAGE_SIZE);
+        std::memcpy(dst + (from - pos), it->second.data.data() + (from - start), to - from);
+    }
+}
+void WriteAheadLog::FileLog::write(const char* src, long long pos, size_t len) {
+    std::unique_lock lock(mutex);
+    const long long last = pos + static_cast<long long>(len);
+    if (end < last) end = last;
+    if (detached) {
+        backend.write(src, pos, len);
+        return;
+    }
+    const uint64_t epoch = log.append(this, src, pos, len);
+    for (long long page_no = pos / PAGE_SIZE; page_no * PAGE_SIZE < last; ++page_no) {
+        const long long start = page_no * PAGE_SIZE;
+        const long long from = std::max(pos, start), to = std::min(last, start + PAGE_SIZE);
+        auto [it, inserted] = pages.try_emplace(page_no);
+        Page& page = it->second;
+        if (inserted) {
+            page.data.resize(PAGE_SIZE);
+            // a page overwritten as a whole needn't be read
+            if (to - from < PAGE_SIZE) backend.read(page.data.data(), start, PAGE_SIZE);
+        }
+        std::memcpy(page.data.data() + (from - start), src + (from - pos), to - from);
+        page.epoch = epoch;
+    }
+}
+void WriteAheadLog::FileLog::close() {
+    {
+        std::shared_lock lock(mutex);
+        if (detached) return;
+    }
+    log.flush();
+    backend.sync();
+    std::lock_guard lock(log.files_mutex);
+    std::erase(log.files, this);
+}
+
+uint64_t WriteAheadLog::append(FileLog* f, const char* src, long long pos, size_t len) {
+    std::lock_guard lock(mutex);
+    current.entries.push_back({f, pos, current.data.size(), len});
+    current.data.append(src, len);
+    if (transaction_depth) transaction_epoch = epoch;
+    if (current.data.size() >= MAX_BATCH_SIZE) cv.notify_all();
+    return epoch;
+}
+void WriteAheadLog::waitFor(uint64_t target, bool applied) {
+    std::unique_lock lock(mutex);
+    requested_epoch = std::max(requested_epoch, target);
+    cv.notify_all();
+    cv.wait(lock, [&] { return (applied ? applied_epoch : durable_epoch) >= target; });
+}
+void WriteAheadLog::runCommitter() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        // the transactions that end while a batch is being synced are committed together next
+        cv.wait_for(lock, COMMIT_INTERVAL, [this] {
+            return stopping || requested_epoch >= epoch || current.data.size() >= MAX_BATCH_SIZE;
+        });
+        if (current.entries.empty() && requested_epoch < epoch) {
+            if (stopping) return;
+            continue;
+        }
+        lock.unlock();
+        const Batch batch = seal();
+        if (!batch.entries.empty()) commit(batch);
+        lock.lock();
+        durable_epoch = batch.epoch;
+        cv.notify_all();
+        lock.unlock();
+        apply(batch);
+        if (log_size >= CHECKPOINT_SIZE) checkpoint();
+        lock.lock();
+        applied_epoch = batch.epoch;
+        cv.notify_all();
+    }
+}
+WriteAheadLog::Batch WriteAheadLog::seal() {
+    // wait for the running transactions, so that each of them is in a single batch
+    std::unique_lock gate_lock(gate);
+    std::lock_guard lock(mutex);
+    Batch batch = std::move(current);
+    current = {};
+    batch.epoch = epoch++;
+    return batch;
+}
+void WriteAheadLog::commit(const Batch& batch) {
+    // the files in the batch, which the writes refer to by index
+    std::vector<const FileLog*> names;
+    for (const auto& entry : batch.entries) {
+        if (std::ranges::find(names, entry.file) == names.end()) names.push_back(entry.file);
+    }
+    std::string record(sizeof(Header), '\0');
+    record.reserve(sizeof(Header) + batch.data.size() + batch.entries.size() * 14);
+    put<uint16_t>(record, names.size());
+    for (const FileLog* f : names) {
+        put<uint16_t>(record, f->name.size());
+        record += f->name;
+    }
+    for (const auto& entry : batch.entries) {
+        put<uint16_t>(record, std::ranges::find(names, entry.file) - names.begin());
+        put<int64_t>(record, entry.pos);
+        put<uint32_t>(record, entry.len);
+        record.append(batch.data, entry.offset, entry.len);
+    }
+    const std::string_view body(record.data() + sizeof(Header), record.size() - sizeof(Header));
+    const Header header{MAGIC, static_cast<uint32_t>(body.size()), batch.epoch, checksum(body)};
+    std::memcpy(record.data(), &header, sizeof(Header));
+    file->write(record.data(), log_size, record.size());
+    file->sync();
+    log_size += static_cast<long long>(record.size());
+    ++commit_count;
+}
+void WriteAheadLog::apply(const Batch& batch) {
+    std::vector<FileLog*> targets;
+    for (const auto& entry : batch.entries) {
+        if (std::ranges::find(targets, entry.file) == targets.end()) targets.push_back(entry.file);
+    }
+    for (FileLog* f : targets) {
+        std::unique_lock lock(f->mutex);
+        for (const auto& entry : batch.entries) {
+            if (entry.file != f) continue;
+            f->backend.write(batch.data.data() + entry.offset, entry.pos, entry.len);
+        }
+        // the pages written in later epochs are kept until those are applied
+        std::erase_if(f->pages,
+                      [&batch](const auto& page) { return page.second.epoch <= batch.epoch; });
+    }
+}
+void WriteAheadLog::checkpoint() {
+    std::lock_guard lock(files_mutex);
+    for (FileLog* f : files) f->backend.sync();
+    file->truncate(0);
+    file->sync();
+    log_size = 0;
+}
+size_t WriteAheadLog::recover() {
+    std::string log(file->size(), '\0');
+    file->read(log.data(), 0, log.size());
+    std::unordered_map<std::string, std::unique_ptr<PagedFile>> targets;
+    size_t replayed = 0;
+    uint64_t last_epoch = 0;
+    for (size_t pos = 0; log.size() - pos >= sizeof(Header); ++replayed) {
+        Header header;
+        std::memcpy(&header, log.data() + pos, sizeof(Header));
+        pos += sizeof(Header);
+        // stop at a torn or stale batch
+        if (header.magic != MAGIC || header.epoch <= last_epoch || header.size > log.size() - pos) {
+            break;
+        }
+        const std::string_view body(log.data() + pos, header.size);
+        if (checksum(body) != header.checksum) break;
+        pos += header.size;
+        last_epoch = header.epoch;
+
+        size_t p = 0;
+        uint16_t file_count = 0;
+        get(body, p, file_count);
+        std::vector<PagedFile*> files_in_batch;
+        for (int i = 0; i < file_count; i++) {
+            uint16_t length = 0;
+            get(body, p, length);
+            const std::string name(body.substr(p, length));
+            p += length;
+            auto& target = targets[name];
+            if (!target) {
+                target = std::make_unique<PagedFile>();
+                target->open(name);
+            }
+            files_in_batch.push_back(target.get());
+        }
+        uint16_t index;
+        int64_t at;
+        uint32_t length;
+        while (get(body, p, index) && get(body, p, at) && get(body, p, length)) {
+            files_in_batch.at(index)->write(body.data() + p, at, length);
+            p += length;
+        }
+    }
+    for (auto& [name, target] : targets) target->sync();
+    file->truncate(0);
+    file->sync();
+    return replayed;
+}
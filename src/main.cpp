@@ -7,9 +7,15 @@
 #include "Parser/Parser.hpp"
 #include "UsersManager.hpp"
 #include "Utils.hpp"
+#include "WriteAheadLog.hpp"
 
 int main() {
-    std::stack<std::pair<User::USERID_T, int>> login_stack;
+    // replays the writes committed before a crash, so it must come before the managers open their
+    // files; a single user gains nothing from group commit, so the commands don't wait for the sync
+    WriteAheadLog::getInstance().open("write_ahead_log", WriteAheadLog::Durability::ASYNC);
+    // the sessions of the users logged in, the last of which is the current one
+    std::stack<ExecutionContext> login_stack;
+    ExecutionContext guest;
 
     std::string line;
     while (std::getline(std::cin, line)) {
@@ -25,26 +31,17 @@ int main() {
 
         try {
             auto command = parseCommand(tokens);
-            User::USERID_T current_user = !login_stack.empty()
-                                              ? login_stack.top().first
-                                              : util::toArray<User::USERID_T>("<GUEST>");
-            int privilege = UsersManager::getInstance().getUserByUserid(current_user).privilege;
-            int current_book = !login_stack.empty() ? login_stack.top().second : 0;
-
+            ExecutionContext& ctx = !login_stack.empty() ? login_stack.top() : guest;
 
             if (dynamic_cast<SwitchUserCommand*>(command.get())) {
-                User::USERID_T new_userid = current_user;
-                int new_selected_book = 0;
-                command->execute(new_userid, new_selected_book, std::cout);
-                login_stack.emplace(new_userid, new_selected_book);
+                ExecutionContext new_ctx = ctx;
+                command->execute(new_ctx, std::cout);
+                login_stack.push(new_ctx);
             } else if (dynamic_cast<LogoutCommand*>(command.get())) {
-                command->execute(current_user, current_book, std::cout);
+                command->execute(ctx, std::cout);
                 login_stack.pop();
-            } else if (dynamic_cast<SelectCommand*>(command.get())) {
-                command->execute(current_user, current_book, std::cout);
-                login_stack.top().second = current_book;
             } else {
-                command->execute(current_user, current_book, std::cout);
+                command->execute(ctx, std::cout);
             }
         } catch (const std::exception& e) {
             std::cerr << "[VERBOSE] From main:" << e.what() << std::endl;
@@ -53,7 +50,7 @@ int main() {
     }
 
     while (!login_stack.empty()) {
-        LogoutCommand{}.execute(login_stack.top().first, login_stack.top().second, std::cout);
+        LogoutCommand{}.execute(login_stack.top(), std::cout);
         login_stack.pop();
     }
 }
\ No newline at end of file
@@ -1,13 +1,19 @@
 #include <jwt-cpp/jwt.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
 #include <nlohmann/json.hpp>
 #include <sstream>
 
+#include "BooksManager.hpp"
 #include "Commands/BookCommands.hpp"
 #include "Commands/LogCommands.hpp"
 #include "Commands/UserCommands.hpp"
+#include "LogManager.hpp"
 #include "Parser/FieldParser.hpp"
 #include "UsersManager.hpp"
+#include "WriteAheadLog.hpp"
 #include "crow.h"
 #include "crow/middlewares/cors.h"
 
@@ -16,16 +22,13 @@ const std::string SECRET_KEY = "#ILove1dentityV-Di5rengeZhenh@owan$";
 using json = nlohmann::json;
 
 struct AuthMiddleware {
-    struct context {
-        User::USERID_T userid;
-        int selected_id;
-    };
+    // The session of the request, whose user the commands read once each.
+    struct context : ExecutionContext {};
     void before_handle(crow::request& req, crow::response& res, context& ctx) {
         CROW_LOG_INFO << "BEFORE_HANDLER_CALLED (AUTH)" << '\n';
         const auto& auth_header = req.get_header_value("Authorization");
         if (auth_header.empty()) {
-            ctx.userid = util::toArray<User::USERID_T>("<GUEST>");
-            ctx.selected_id = 0;
+            static_cast<ExecutionContext&>(ctx) = ExecutionContext();
             return;
         }
         CROW_LOG_DEBUG << "auth_header: " << auth_header << '\n';
@@ -44,9 +47,9 @@ struct AuthMiddleware {
             auto decoded = jwt::decode(token);
             verifier.verify(decoded);
 
-            ctx.userid =
-                util::toArray<User::USERID_T>(decoded.get_payload_claim("userid").as_string());
-            ctx.selected_id = decoded.get_payload_claim("selected_id").as_integer();
+            static_cast<ExecutionContext&>(ctx) = ExecutionContext(
+                util::toArray<User::USERID_T>(decoded.get_payload_claim("userid").as_string()),
+                decoded.get_payload_claim("selected_id").as_integer());
         } catch (const std::exception& e) {
             res.code = 401;
             res.write(e.what());
@@ -57,7 +60,53 @@ struct AuthMiddleware {
     void after_handle(crow::request&, crow::response&, context&) {}
 };
 
+// The books are written as JSON directly into a buffer, reserving BOOK_JSON_SIZE bytes for each.
+constexpr size_t BOOK_JSON_SIZE = 160;
+void appendJsonString(std::string& out, const char* str) {
+    out += '"';
+    for (; *str; ++str) {
+        const unsigned char c = *str;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+void appendInteger(std::string& out, long long value) {
+    char digits[24];
+    out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+void appendBookJson(std::string& out, const Book& book) {
+    out += "{\"isbn\":";
+    appendJsonString(out, book.ISBN.data());
+    out += ",\"name\":";
+    appendJsonString(out, book.book_name.data());
+    out += ",\"author\":";
+    appendJsonString(out, book.author.data());
+    out += ",\"keyword\":";
+    appendJsonString(out, book.keywords.data());
+    // the price is a string, so that it keeps its two decimal places
+    out += ",\"price\":\"";
+    appendInteger(out, book.price / 100);
+    out += '.';
+    out += static_cast<char>('0' + book.price % 100 / 10);
+    out += static_cast<char>('0' + book.price % 10);
+    out += "\",\"quantity\":";
+    appendInteger(out, book.quantity);
+    out += '}';
+}
+
 int main() {
+    // replays the writes committed before a crash, so it must come before the managers open their
+    // files; each command is then committed as a whole, with a single sync for many of them
+    WriteAheadLog::getInstance().open("write_ahead_log");
     crow::App<crow::CORSHandler, AuthMiddleware> app;
     // app.loglevel(crow::LogLevel::Debug);
     auto& cors = app.get_middleware<crow::CORSHandler>();
@@ -73,7 +122,7 @@ int main() {
         .methods("POST"_method)([&app](const crow::request& req, crow::response& res) {
             auto& ctx = app.get_context<AuthMiddleware>(req);
 
-            CROW_LOG_INFO << "auth/login, " << "userid: " << util::toString(ctx.userid)
+            CROW_LOG_INFO << "auth/login, " << "userid: " << util::toString(ctx.userid())
                           << ", select_id: " << ctx.selected_id << '\n';
             // 1. Content-Type 必须要是 json
             if (auto content_type = req.get_header_value("Content-Type");
@@ -103,7 +152,7 @@ int main() {
                                                         userid, parse_password(j["password"]))
                                                   : std::make_unique<SwitchUserCommand>(userid);
 
-                cmd->execute(ctx.userid, ctx.selected_id, std::cout);
+                cmd->execute(ctx, std::cout);
 
                 const auto time = jwt::date::clock::now();
                 auto token =
@@ -118,7 +167,8 @@ int main() {
                 json j;
                 j["message"] = "Success.";
                 j["access_token"] = token;
-                const auto& user = UsersManager::getInstance().getUserByUserid(userid);
+                // the command has switched the session to the user
+                const User& user = ctx.user;
                 j["username"] = util::toString(user.username);
                 j["privilege"] = user.privilege;
                 res.code = 200;
@@ -140,7 +190,7 @@ int main() {
         .methods("POST"_method)([&app](const crow::request& req, crow::response& res) {
             auto& ctx = app.get_context<AuthMiddleware>(req);
             // TODO(llx) add this token to blacklist.
-            if (util::toString(ctx.userid) == "<GUEST>") {
+            if (util::toString(ctx.userid()) == "<GUEST>") {
                 res.code = 400;
                 json j;
                 j["message"] = "Cannot log out guest user.";
@@ -151,7 +201,7 @@ int main() {
             }
 
             try {
-                LogoutCommand().execute(ctx.userid, ctx.selected_id, std::cout);
+                LogoutCommand().execute(ctx, std::cout);
                 json j;
                 j["message"] = "Success.";
                 res.write(j.dump());
@@ -196,8 +246,7 @@ int main() {
                     auto userid = parse_userid(j["userid"]);
                     auto password = parse_password(j["password"]);
                     auto username = parse_username(j["username"]);
-                    RegisterCommand(userid, password, username)
-                        .execute(ctx.userid, ctx.selected_id, std::cout);
+                    RegisterCommand(userid, password, username).execute(ctx, std::cout);
                     json j;
                     j["message"] = "Success.";
                     res.code = 200;
@@ -217,8 +266,7 @@ int main() {
                     auto password = parse_password(j["password"]);
                     auto username = parse_username(j["username"]);
                     int privilege = j["privilege"].get<int>();
-                    AddUserCommand(userid, password, privilege, username)
-                        .execute(ctx.userid, ctx.selected_id, std::cout);
+                    AddUserCommand(userid, password, privilege, username).execute(ctx, std::cout);
                     json j;
                     j["message"] = "Success.";
                     res.code = 200;
@@ -265,10 +313,9 @@ int main() {
                     if (j.contains("current_password")) {
                         auto current_password = parse_password(j["current_password"]);
                         ChangePasswordCommand(userid, current_password, new_password)
-                            .execute(ctx.userid, ctx.selected_id, std::cout);
+                            .execute(ctx, std::cout);
                     } else {
-                        ChangePasswordCommand(userid, new_password)
-                            .execute(ctx.userid, ctx.selected_id, std::cout);
+                        ChangePasswordCommand(userid, new_password).execute(ctx, std::cout);
                     }
                     json j;
                     j["message"] = "Success.";
@@ -291,7 +338,7 @@ int main() {
                 auto& ctx = app.get_context<AuthMiddleware>(req);
                 try {
                     auto userid = parse_userid(userid_str);
-                    DeleteUserCommand(userid).execute(ctx.userid, ctx.selected_id, std::cout);
+                    DeleteUserCommand(userid).execute(ctx, std::cout);
                     json j;
                     j["message"] = "Success.";
                     res.code = 200;
@@ -314,82 +361,80 @@ int main() {
             auto& ctx = app.get_context<AuthMiddleware>(req);
 
             try {
-                const char* isbn_ptr = req.url_params.get("isbn");
-                const char* name_ptr = req.url_params.get("name");
-                const char* author_ptr = req.url_params.get("author");
-                const char* keyword_ptr = req.url_params.get("keyword");
-
-                std::string isbn = isbn_ptr ? isbn_ptr : "";
-                std::string name = name_ptr ? name_ptr : "";
-                std::string author = author_ptr ? author_ptr : "";
-                std::string keyword = keyword_ptr ? keyword_ptr : "";
-
-                int param_count = 0;
-                if (isbn_ptr) {
-                    ++param_count;
+                // the given filters are combined with AND
+                ShowCommand cmd;
+                if (const char* isbn = req.url_params.get("isbn")) {
+                    cmd.ISBN = parseISBN(isbn);
                 }
-                if (name_ptr) {
-                    ++param_count;
+                if (const char* name = req.url_params.get("name")) {
+                    cmd.name = parseBookName(name);
                 }
-                if (author_ptr) {
-                    ++param_count;
+                if (const char* author = req.url_params.get("author")) {
+                    cmd.author = parseAuthor(author);
                 }
-                if (keyword_ptr) {
-                    ++param_count;
+                // substrings of the name and the author, for searching as the user types
+                if (const char* name = req.url_params.get("name_contains")) {
+                    cmd.name_contains = parseBookName(name);
                 }
-
-                if (param_count > 1) {
-                    json err;
-                    err["message"] = "Too many parameters.";
-                    res.code = 400;
-                    res.write(err.dump());
-                    res.set_header("Content-Type", "application/json");
-                    res.end();
-                    return;
+                if (const char* author = req.url_params.get("author_contains")) {
+                    cmd.author_contains = parseAuthor(author);
                 }
-
-                ShowCommand cmd;
-                if (isbn_ptr) {
-                    cmd.ISBN = parseISBN(isbn);
+                // inclusive bounds of the price and the quantity
+                if (const char* price = req.url_params.get("min_price")) {
+                    cmd.min_price = parsePrice(price);
                 }
-                if (name_ptr) {
-                    cmd.name = parseBookName(name);
+                if (const char* price = req.url_params.get("max_price")) {
+                    cmd.max_price = parsePrice(price);
                 }
-                if (author_ptr) {
-                    cmd.author = parseAuthor(author);
+                if (const char* quantity = req.url_params.get("min_quantity")) {
+                    cmd.min_quantity = parseStockLevel(quantity);
                 }
-                if (keyword_ptr) {
-                    cmd.keyword = parseKeyword(keyword);
+                if (const char* quantity = req.url_params.get("max_quantity")) {
+                    cmd.max_quantity = parseStockLevel(quantity);
                 }
-
-                std::ostringstream oss;
-                cmd.execute(ctx.userid, ctx.selected_id, oss);
-                std::string data = oss.str();
-                auto lines = util::split(data, '\n');
-                json json_res = json::array();
-                for (const std::string& line : lines) {
-                    if (line.empty()) {
-                        continue;
+                // with limit, a page of books is returned with the cursor of the next page
+                const char* limit = req.url_params.get("limit");
+                if (limit) cmd.page.limit = parseCount(limit);
+                if (const char* cursor = req.url_params.get("cursor")) {
+                    cmd.page.after = parseISBN(cursor);
+                }
+                // keyword (all of), any_keyword (at least one of) and exclude_keyword (none of)
+                // may be repeated, and each one may list several keywords with '|'
+                auto addKeywords = [&req](const char* param, std::vector<Book::KEYWORD_T>& to) {
+                    for (const char* keyword : req.url_params.get_list(param, false)) {
+                        for (const auto& single :
+                             util::split(util::toString(parseKeyword(keyword)))) {
+                            to.push_back(util::toArray<Book::KEYWORD_T>(single));
+                        }
                     }
-                    auto fields = util::split(line, '\t');
-                    try {
-                        json book;
-                        if (fields.size() < 6) continue;
-                        book["isbn"] = fields[0];
-                        book["name"] = fields[1];
-                        book["author"] = fields[2];
-                        book["keyword"] = fields[3];
-                        book["price"] = fields[4];
-                        book["quantity"] = fields[5];
-                        json_res.push_back(book);
-                    } catch (const std::exception& e) {
-                        CROW_LOG_WARNING << "show book error: " << e.what() << '\n';
-                        continue;
+                };
+                addKeywords("keyword", cmd.keywords);
+                addKeywords("any_keyword", cmd.any_keywords);
+                addKeywords("exclude_keyword", cmd.excluded_keywords);
+
+                // the books are written as they are read
+                std::string body;
+                body.reserve(std::min<size_t>(cmd.page.limit, 1024) * BOOK_JSON_SIZE);
+                body += limit ? "{\"books\":[" : "[";
+                Book::ISBN_T last_ISBN{};
+                const bool has_more = cmd.forEachResult(ctx, [&](const Book& book) {
+                    if (body.back() != '[') body += ',';
+                    appendBookJson(body, book);
+                    last_ISBN = book.ISBN;
+                });
+                body += ']';
+                if (limit) {
+                    body += ",\"next_cursor\":";
+                    if (has_more) {
+                        appendJsonString(body, last_ISBN.data());
+                    } else {
+                        body += "null";
                     }
+                    body += '}';
                 }
                 res.code = 200;
                 res.set_header("Content-Type", "application/json");
-                res.write(json_res.dump());
+                res.write(body);
                 res.end();
             } catch (const std::exception& e) {
                 json err{{"message", e.what()}};
@@ -407,12 +452,12 @@ int main() {
             auto& ctx = app.get_context<AuthMiddleware>(req);
             try {
                 const Book::ISBN_T& isbn = parseISBN(isbn_str);
-                SelectCommand(isbn).execute(ctx.userid, ctx.selected_id, std::cout);
+                SelectCommand(isbn).execute(ctx, std::cout);
                 const auto time = jwt::date::clock::now();
                 auto token =
                     jwt::create()
                         .set_issuer("linlexiao")
-                        .set_payload_claim("userid", jwt::claim(util::toString(ctx.userid)))
+                        .set_payload_claim("userid", jwt::claim(util::toString(ctx.userid())))
                         .set_payload_claim("selected_id",
                                            jwt::claim(picojson::value(int64_t{ctx.selected_id})))
                         .set_issued_at(time)
@@ -464,7 +509,7 @@ int main() {
                 auto isbn = parseISBN(j["isbn"]);
                 auto quantity = parseQuantity(j["quantity"]);
                 std::ostringstream oss;
-                BuyCommand(isbn, quantity).execute(ctx.userid, ctx.selected_id, oss);
+                BuyCommand(isbn, quantity).execute(ctx, oss);
 
                 res.code = 200;
                 json j;
@@ -515,7 +560,7 @@ int main() {
                 if (j.contains("keyword")) cmd.new_keyword = parseKeyword(j["keyword"]);
                 if (j.contains("price")) cmd.new_price = parsePrice(j["price"]);
 
-                cmd.execute(ctx.userid, ctx.selected_id, std::cout);
+                cmd.execute(ctx, std::cout);
 
                 res.code = 200;
                 res.set_header("Content-Type", "application/json");
@@ -558,7 +603,7 @@ int main() {
                 auto quantity = parseQuantity(j["quantity"]);
                 auto total_cost = parsePrice(j["total_cost"]);
                 std::ostringstream oss;
-                ImportCommand(quantity, total_cost).execute(ctx.userid, ctx.selected_id, std::cout);
+                ImportCommand(quantity, total_cost).execute(ctx, std::cout);
                 res.code = 200;
                 json j;
                 res.write(j.dump());
@@ -583,14 +628,14 @@ int main() {
                     int count = parseCount(req.url_params.get("count"));
                     ShowFinanceCommand cmd(count);
                     std::ostringstream oss;
-                    cmd.execute(ctx.userid, ctx.selected_id, oss);
+                    cmd.execute(ctx, oss);
                     res.write(oss.str());
                     res.end();
                     return;
                 }
                 ShowFinanceCommand cmd;
                 std::ostringstream oss;
-                cmd.execute(ctx.userid, ctx.selected_id, oss);
+                cmd.execute(ctx, oss);
                 res.write(oss.str());
                 res.end();
             } catch (const std::exception& e) {
@@ -609,7 +654,7 @@ int main() {
             try {
                 ReportFinanceCommand cmd;
                 std::ostringstream oss;
-                cmd.execute(ctx.userid, ctx.selected_id, oss);
+                cmd.execute(ctx, oss);
                 res.write(oss.str());
                 res.end();
             } catch (const std::exception& e) {
@@ -628,7 +673,7 @@ int main() {
             try {
                 ReportEmployeeCommand cmd;
                 std::ostringstream oss;
-                cmd.execute(ctx.userid, ctx.selected_id, oss);
+                cmd.execute(ctx, oss);
                 res.write(oss.str());
                 res.end();
             } catch (const std::exception& e) {
@@ -647,7 +692,7 @@ int main() {
             try {
                 LogCommand cmd;
                 std::ostringstream oss;
-                cmd.execute(ctx.userid, ctx.selected_id, oss);
+                cmd.execute(ctx, oss);
                 res.write(oss.str());
                 res.end();
             } catch (const std::exception& e) {
@@ -693,6 +738,10 @@ int main() {
         }
     });
 
+    // the operation log is written in the background; the log reports flush it before reading
+    LogManager::getInstance().setAsyncOperationLog(true);
+    // the lookups by ISBN read the books in memory, and don't wait for buy and import
+    BooksManager::getInstance().enableSnapshots();
     app.port(10086).multithreaded().run();
     return 0;
 }
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <climits>
+#include <filesystem>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "BPlusTree.hpp"
+#include "BlockList.hpp"
+
+namespace {
+// A large key makes the fanout small, so that the tree gets deep with few elements.
+using WideKey = std::array<int, 100>;
+WideKey wideKey(int k) {
+    WideKey key{};
+    key[0] = k;
+    return key;
+}
+}  // namespace
+
+TEST_CASE("BPlusTree Basic Insert And Delete", "[BPlusTree]") {
+    std::filesystem::remove("data");
+    BPlusTree<int, int> tree;
+    tree.initialise("data");
+    auto data = std::vector<int>{6, 1, 2, 3, 4};
+    const int key = 114514;
+    for (auto v : data) tree.insert(key, v);
+    tree.insert(key, 6);  // duplicated pairs are ignored
+    std::ranges::sort(data);
+    REQUIRE(tree.query(key) == data);
+    REQUIRE(tree.query(key + 1).empty());
+    for (auto v : data) tree.erase(key, v);
+    REQUIRE(tree.query(key).empty());
+    REQUIRE(tree.queryAll().empty());
+    for (auto v : data) tree.insert(key, v);
+    REQUIRE(tree.query(key) == data);
+}
+
+TEST_CASE("BPlusTree Massive Insert With Reopen", "[BPlusTree]") {
+    std::filesystem::remove("data");
+    std::vector<unsigned> data;
+    const int N = 100000;
+    std::mt19937 gen{14514};
+    for (int i = 0; i < N; i++) {
+        data.push_back(gen());
+    }
+    {
+        BPlusTree<int, unsigned> tree;
+        tree.initialise("data");
+        for (auto v : data) tree.insert(v % 7, v);
+    }
+    // the header and every node fill whole pages
+    REQUIRE(std::filesystem::file_size("data") % PagedFile::PAGE_SIZE == 0);
+    {
+        BPlusTree<int, unsigned> tree;
+        tree.initialise("data");
+        for (int key = 0; key < 7; key++) {
+            std::vector<unsigned> expected;
+            for (auto v : data) {
+                if (v % 7 == key) expected.push_back(v);
+            }
+            std::ranges::sort(expected);
+            REQUIRE(tree.query(key) == expected);
+        }
+        REQUIRE(tree.queryAll().size() == N);
+    }
+}
+
+TEST_CASE("BPlusTree Random Operations With Reopen", "[BPlusTree]") {
+    std::filesystem::remove("data");
+    std::set<std::pair<int, int>> reference;
+    std::mt19937 gen{1919810};
+    for (int round = 0; round < 6; round++) {
+        BPlusTree<WideKey, int> tree;
+        tree.initialise("data");
+        // the tree grows in the first rounds and shrinks to empty in the last ones
+        const int insert_weight = round < 3 ? 3 : 1;
+        for (int i = 0; i < 5000; i++) {
+            int key = gen() % 50, value = gen() % 1000;
+            if (gen() % (insert_weight + 1)) {
+                tree.insert(wideKey(key), value);
+                reference.emplace(key, value);
+            } else {
+                tree.erase(wideKey(key), value);
+                reference.erase({key, value});
+            }
+        }
+        if (round == 5) {
+            for (auto [key, value] : std::vector(reference.begin(), reference.end())) {
+                tree.erase(wideKey(key), value);
+                reference.erase({key, value});
+            }
+        }
+        for (int key = 0; key < 50; key++) {
+            std::vector<int> expected;
+            for (auto it = reference.lower_bound({key, INT_MIN});
+                 it != reference.end() && it->first == key; ++it) {
+                expected.push_back(it->second);
+            }
+            REQUIRE(tree.query(wideKey(key)) == expected);
+        }
+        const auto pairs = tree.queryAllKeyValuePairs();
+        REQUIRE(pairs.size() == reference.size());
+        REQUIRE(std::ranges::is_sorted(pairs));
+    }
+}
+
+TEST_CASE("BPlusTree Bulk Load From BlockList", "[BPlusTree]") {
+    std::filesystem::remove("data");
+    std::filesystem::remove("data_tree");
+    std::mt19937 gen{114514};
+    {
+        BlockList<WideKey, int> blocklist;
+        blocklist.initialise("data");
+        for (int i = 0; i < 3000; i++) blocklist.insert(wideKey(gen() % 100), i);
+    }
+    BlockList<WideKey, int> blocklist;
+    blocklist.initialise("data");
+    const auto pairs = blocklist.queryAllKeyValuePairs();
+    {
+        BPlusTree<WideKey, int> tree;
+        tree.initialise("data_tree");
+        tree.bulkLoad(pairs);
+    }
+    // the tree is told apart from the BlockList by its marker
+    REQUIRE(BPlusTree<WideKey, int>::isTreeFile("data_tree"));
+    REQUIRE(!BPlusTree<WideKey, int>::isTreeFile("data"));
+    REQUIRE(!BPlusTree<WideKey, int>::isTreeFile("no_such_file"));
+    BPlusTree<WideKey, int> tree;
+    tree.initialise("data_tree");
+    REQUIRE(tree.queryAllKeyValuePairs() == pairs);
+    for (int key = 0; key < 100; key++) {
+        REQUIRE(tree.query(wideKey(key)) == blocklist.query(wideKey(key)));
+    }
+    // the loaded tree is updated as usual
+    for (int i = 0; i < 3000; i += 2) {
+        tree.erase(pairs[i].first, pairs[i].second);
+        blocklist.erase(pairs[i].first, pairs[i].second);
+    }
+    for (int i = 3000; i < 4000; i++) {
+        tree.insert(wideKey(gen() % 100), i);
+    }
+    for (int key = 0; key < 100; key++) {
+        auto result = tree.query(wideKey(key));
+        std::erase_if(result, [](int v) { return v >= 3000; });
+        REQUIRE(result == blocklist.query(wideKey(key)));
+    }
+    REQUIRE(tree.queryAll().size() == 1500 + 1000);
+}
+
+TEST_CASE("BPlusTree Iterator And Range", "[BPlusTree]") {
+    std::filesystem::remove("data");
+    BPlusTree<WideKey, int> tree;
+    tree.initialise("data");
+    REQUIRE(tree.begin() == tree.end());
+    REQUIRE(tree.range(wideKey(0), wideKey(10)).empty());
+    std::multiset<std::pair<int, int>> reference;
+    std::mt19937 gen{114514};
+    for (int i = 0; i < 3000; i++) {
+        // many duplicate keys, so that the values of a key span several leaves
+        const int key = gen() % 50;
+        tree.insert(wideKey(key), i);
+        reference.emplace(key, i);
+    }
+    auto toPairs = [](auto&& range) {
+        std::vector<std::pair<int, int>> pairs;
+        for (const auto& [key, value] : range) pairs.emplace_back(key[0], value);
+        return pairs;
+    };
+    REQUIRE(std::ranges::equal(toPairs(std::ranges::subrange(tree.begin(), tree.end())),
+                               reference));
+    for (int lo = -2; lo <= 52; lo++) {
+        for (int hi : {lo - 1, lo, lo + 3}) {
+            std::vector<std::pair<int, int>> expected;
+            for (const auto& pair : reference) {
+                if (lo <= pair.first && pair.first <= hi) expected.push_back(pair);
+            }
+            REQUIRE(toPairs(tree.range(wideKey(lo), wideKey(hi))) == expected);
+        }
+        auto it = tree.begin(wideKey(lo));
+        auto expected_it = reference.lower_bound({lo, INT_MIN});
+        if (expected_it == reference.end()) {
+            REQUIRE(it == tree.end());
+        } else {
+            REQUIRE((*it).first[0] == expected_it->first);
+            REQUIRE((*it).second == expected_it->second);
+        }
+    }
+}
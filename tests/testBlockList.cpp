@@ -1,10 +1,12 @@
 #include <algorithm>
 #include <catch2/catch_test_macros.hpp>
+#include <climits>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <random>
 #include <ranges>
+#include <set>
 #include <vector>
 
 #include "BlockList.hpp"
@@ -121,4 +123,86 @@ TEST_CASE("BlockList Query All", "[BlockList]") {
     auto result = blocklist.queryAll();
     std::ranges::sort(result);
     REQUIRE(result == data);
-}
\ No newline at end of file
+}
+TEST_CASE("BlockList Random Operations With Reopen", "[BlockList]") {
+    std::filesystem::remove("data");
+    std::multiset<std::pair<int, int>> reference;
+    std::mt19937 gen{1919810};
+    for (int round = 0; round < 4; round++) {
+        // the block directory is rebuilt from the file each round
+        BlockList<int, int> blocklist;
+        blocklist.initialise("data");
+        for (int i = 0; i < 5000; i++) {
+            int key = gen() % 50, value = gen() % 1000;
+            if (gen() % 3) {
+                if (!reference.contains({key, value})) {
+                    blocklist.insert(key, value);
+                    reference.emplace(key, value);
+                }
+            } else {
+                blocklist.erase(key, value);
+                reference.erase({key, value});
+            }
+        }
+        for (int key = 0; key < 50; key++) {
+            std::vector<int> expected;
+            for (auto it = reference.lower_bound({key, INT_MIN});
+                 it != reference.end() && it->first == key; ++it) {
+                expected.push_back(it->second);
+            }
+            REQUIRE(blocklist.query(key) == expected);
+        }
+        REQUIRE(blocklist.queryAll().size() == reference.size());
+    }
+}
+
+TEST_CASE("BlockList Query Across Blocks With Callback", "[BlockList]") {
+    std::filesystem::remove("data");
+    BlockList<int, int> blocklist;
+    blocklist.initialise("data");
+    // the values of key 1 span several blocks, surrounded by the other keys
+    for (int i = 0; i < 3000; i++) blocklist.insert(i % 3, i);
+    for (int key = -1; key <= 3; key++) {
+        std::vector<int> expected;
+        for (int i = 0; i < 3000; i++) {
+            if (i % 3 == key) expected.push_back(i);
+        }
+        std::vector<int> result;
+        blocklist.query(key, [&result](int value) { result.push_back(value); });
+        REQUIRE(result == expected);
+        REQUIRE(blocklist.query(key) == expected);
+    }
+}
+
+TEST_CASE("BlockList Iterator And Range", "[BlockList]") {
+    std::filesystem::remove("data");
+    BlockList<int, int> blocklist;
+    blocklist.initialise("data");
+    REQUIRE(blocklist.begin() == blocklist.end());
+    REQUIRE(blocklist.range(0, 10).empty());
+    std::multiset<std::pair<int, int>> reference;
+    std::mt19937 gen{114514};
+    for (int i = 0; i < 5000; i++) {
+        const int key = gen() % 500;
+        blocklist.insert(key, i);
+        reference.emplace(key, i);
+    }
+    std::vector<std::pair<int, int>> all(blocklist.begin(), blocklist.end());
+    REQUIRE(std::ranges::equal(all, reference));
+    for (int round = 0; round < 100; round++) {
+        const int lo = static_cast<int>(gen() % 520) - 10, hi = lo + gen() % 100;
+        std::vector<std::pair<int, int>> expected;
+        for (const auto& pair : reference) {
+            if (lo <= pair.first && pair.first <= hi) expected.push_back(pair);
+        }
+        std::vector<std::pair<int, int>> result;
+        for (const auto& pair : blocklist.range(lo, hi)) result.push_back(pair);
+        REQUIRE(result == expected);
+        auto it = blocklist.begin(lo);
+        auto expected_it = reference.lower_bound({lo, INT_MIN});
+        for (int i = 0; i < 10 && expected_it != reference.end(); i++, ++it, ++expected_it) {
+            REQUIRE(*it == *expected_it);
+        }
+    }
+    REQUIRE(blocklist.range(10, 9).empty());
+}
@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <atomic>
 #include <catch2/catch_test_macros.hpp>
 #include <filesystem>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "BooksManager.hpp"
 #include "Utils.hpp"
@@ -126,4 +132,529 @@ TEST_CASE("BooksManager Edge Cases", "[BooksManager]") {
         assert(manager.getBooksWithKeyword(Book::KEYWORD_T{}).empty());
         assert(manager.getBooksWithName(Book::BOOKNAME_T{}).empty());
     }
-}
\ No newline at end of file
+}
+TEST_CASE("BooksManager Streaming Queries In ISBN Order", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    std::mt19937 gen{114514};
+    std::vector<std::string> all, rare;
+    for (int i = 0; i < 300; i++) {
+        const std::string ISBN = std::to_string(gen());
+        if (std::ranges::find(all, ISBN) != all.end()) continue;
+        // every book has the common keyword, and a few have the rare one as well
+        const bool is_rare = i % 50 == 0;
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N", "A", is_rare ? "common|rare" : "common", i, i));
+        all.push_back(ISBN);
+        if (is_rare) rare.push_back(ISBN);
+    }
+    std::ranges::sort(all);
+    std::ranges::sort(rare);
+    auto collect = [](auto&& query) {
+        std::vector<std::string> ISBNs;
+        query([&ISBNs](const Book& book) { ISBNs.push_back(util::toString(book.ISBN)); });
+        return ISBNs;
+    };
+    REQUIRE(collect([&](auto func) { manager.forEachBook(func); }) == all);
+    // a large result is merged with the ISBN index, and a small one is sorted
+    REQUIRE(collect([&](auto func) {
+                manager.forEachBookWithKeyword(util::toArray<Book::KEYWORD_T>("common"), func);
+            }) == all);
+    REQUIRE(collect([&](auto func) {
+                manager.forEachBookWithKeyword(util::toArray<Book::KEYWORD_T>("rare"), func);
+            }) == rare);
+    REQUIRE(collect([&](auto func) {
+                manager.forEachBookWithAuthor(util::toArray<Book::AUTHOR_T>("B"), func);
+            }).empty());
+    REQUIRE(manager.getAllBooks().size() == all.size());
+}
+
+TEST_CASE("BooksManager Modify In Place", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    manager.createBook(util::toArray<Book::ISBN_T>("A"));
+    manager.createBook(util::toArray<Book::ISBN_T>("B"));
+    manager.modifyBookData(util::toArray<Book::ISBN_T>("A"),
+                           gen_book("A", "Name", "Author", "K1|K2", 0, 100));
+    const int id = manager.getIdByISBN(util::toArray<Book::ISBN_T>("A"));
+
+    // a price-only modification keeps every index
+    manager.modifyBookData(util::toArray<Book::ISBN_T>("A"),
+                           gen_book("A", "Name", "Author", "K1|K2", 0, 200));
+    REQUIRE(manager.getBookById(id).price == 200);
+    REQUIRE(manager.getBooksWithKeyword(util::toArray<Book::KEYWORD_T>("K1")).size() == 1);
+    REQUIRE(manager.getBooksWithName(util::toArray<Book::BOOKNAME_T>("Name")).size() == 1);
+
+    // only the changed keys are moved
+    manager.modifyBookData(util::toArray<Book::ISBN_T>("A"),
+                           gen_book("C", "Name", "Other", "K2|K3", 0, 200));
+    REQUIRE(manager.getIdByISBN(util::toArray<Book::ISBN_T>("C")) == id);
+    REQUIRE(manager.getBooksWithISBN(util::toArray<Book::ISBN_T>("A")).empty());
+    REQUIRE(manager.getBooksWithAuthor(util::toArray<Book::AUTHOR_T>("Author")).empty());
+    REQUIRE(manager.getBooksWithAuthor(util::toArray<Book::AUTHOR_T>("Other")).size() == 1);
+    REQUIRE(manager.getBooksWithKeyword(util::toArray<Book::KEYWORD_T>("K1")).empty());
+    REQUIRE(manager.getBooksWithKeyword(util::toArray<Book::KEYWORD_T>("K2")).size() == 1);
+    REQUIRE(manager.getBooksWithKeyword(util::toArray<Book::KEYWORD_T>("K3")).size() == 1);
+
+    // changing to an existing ISBN fails without losing the book
+    const Book before = manager.getBookById(id);
+    REQUIRE_THROWS_AS(manager.modifyBookData(util::toArray<Book::ISBN_T>("C"),
+                                             gen_book("B", "X", "Y", "Z", 0, 1)),
+                      std::runtime_error);
+    REQUIRE(manager.getBooksWithISBN(util::toArray<Book::ISBN_T>("C")) == std::vector{before});
+    REQUIRE(manager.getBooksWithISBN(util::toArray<Book::ISBN_T>("B")).size() == 1);
+    REQUIRE(manager.getBooksWithName(util::toArray<Book::BOOKNAME_T>("X")).empty());
+}
+
+TEST_CASE("BooksManager Conjunctive Queries", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    std::mt19937 gen{1919810};
+    // common conditions and rare ones, so that both intersection and filtering are planned
+    for (int i = 0; i < 400; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i * 7919 % 400);
+        const std::string author = gen() % 20 ? "Common" : "Rare";
+        std::string keywords = "K" + std::to_string(gen() % 3);
+        if (gen() % 2) keywords += "|X";
+        if (gen() % 40 == 0) keywords += "|Y";
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N" + std::to_string(i % 2), author, keywords, i, i));
+    }
+    const auto all = manager.getAllBooks();
+    auto hasKeyword = [](const Book& book, const std::string& keyword) {
+        const auto keywords = util::split(book.keywords.data());
+        return std::ranges::find(keywords, keyword) != keywords.end();
+    };
+    for (const char* name : {"", "N0"}) {
+        for (const char* author : {"", "Common", "Rare", "None"}) {
+            for (const std::vector<std::string>& keywords :
+                 std::vector<std::vector<std::string>>{{}, {"X"}, {"Y"}, {"K1", "X"}, {"X", "Y"}}) {
+                BookQuery query;
+                if (*name) query.name = util::toArray<Book::BOOKNAME_T>(name);
+                if (*author) query.author = util::toArray<Book::AUTHOR_T>(author);
+                for (const auto& keyword : keywords) {
+                    query.keywords.push_back(util::toArray<Book::KEYWORD_T>(keyword));
+                }
+                std::vector<Book> expected;
+                for (const auto& book : all) {
+                    if (*name && util::toString(book.book_name) != name) continue;
+                    if (*author && util::toString(book.author) != author) continue;
+                    if (!std::ranges::all_of(keywords, [&](const std::string& keyword) {
+                            return hasKeyword(book, keyword);
+                        })) {
+                        continue;
+                    }
+                    expected.push_back(book);
+                }
+                std::vector<Book> result;
+                manager.forEachBookMatching(query,
+                                            [&result](const Book& book) { result.push_back(book); });
+                REQUIRE(result == expected);
+            }
+        }
+    }
+    BookQuery query;
+    query.ISBN = util::toArray<Book::ISBN_T>("ISBN1");
+    query.author = util::toArray<Book::AUTHOR_T>(util::toString(all[1].author));
+    std::vector<Book> result;
+    manager.forEachBookMatching(query, [&result](const Book& book) { result.push_back(book); });
+    REQUIRE(result == std::vector{all[1]});
+}
+
+TEST_CASE("BooksManager Boolean Keyword Queries", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    std::mt19937 gen{114514};
+    for (int i = 0; i < 300; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i);
+        const std::string author = gen() % 10 ? "Common" : "Rare";
+        std::string keywords = "K" + std::to_string(gen() % 4);
+        if (gen() % 2) keywords += "|X";
+        if (gen() % 30 == 0) keywords += "|Y";
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N", author, keywords, i, i));
+    }
+    // some books lose X, so that the lists are modified after they are built
+    for (int i = 0; i < 300; i += 7) {
+        const auto ISBN = util::toArray<Book::ISBN_T>("ISBN" + std::to_string(i));
+        Book book = manager.getBooksWithISBN(ISBN)[0];
+        book.keywords = util::toArray<Book::KEYWORD_T>("K" + std::to_string(i % 4));
+        manager.modifyBookData(ISBN, book);
+    }
+    const auto all = manager.getAllBooks();
+    auto hasKeyword = [](const Book& book, const std::string& keyword) {
+        const auto keywords = util::split(book.keywords.data());
+        return std::ranges::find(keywords, keyword) != keywords.end();
+    };
+    auto toKeywords = [](const std::vector<std::string>& keywords) {
+        std::vector<Book::KEYWORD_T> result;
+        for (const auto& keyword : keywords) {
+            result.push_back(util::toArray<Book::KEYWORD_T>(keyword));
+        }
+        return result;
+    };
+    using Keywords = std::vector<std::string>;
+    for (const char* author : {"", "Rare"}) {
+        for (const Keywords& all_of : std::vector<Keywords>{{}, {"X"}}) {
+            for (const Keywords& any_of : std::vector<Keywords>{{}, {"K1", "Y"}, {"K0", "K2"}}) {
+                for (const Keywords& none_of : std::vector<Keywords>{{}, {"X"}, {"K3", "Y"}}) {
+                    BookQuery query;
+                    if (*author) query.author = util::toArray<Book::AUTHOR_T>(author);
+                    query.keywords = toKeywords(all_of);
+                    query.any_keywords = toKeywords(any_of);
+                    query.excluded_keywords = toKeywords(none_of);
+                    std::vector<Book> expected;
+                    for (const auto& book : all) {
+                        auto has = [&](const std::string& keyword) {
+                            return hasKeyword(book, keyword);
+                        };
+                        if (*author && util::toString(book.author) != author) continue;
+                        if (!std::ranges::all_of(all_of, has)) continue;
+                        if (!any_of.empty() && !std::ranges::any_of(any_of, has)) continue;
+                        if (std::ranges::any_of(none_of, has)) continue;
+                        expected.push_back(book);
+                    }
+                    std::vector<Book> result;
+                    manager.forEachBookMatching(
+                        query, [&result](const Book& book) { result.push_back(book); });
+                    REQUIRE(result == expected);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("BooksManager Substring Queries", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    std::mt19937 gen{19260817};
+    // short names from a small alphabet, so that n-grams are shared and candidates are often false
+    auto randomString = [&gen](int max_len) {
+        std::string s(gen() % max_len + 1, 'a');
+        for (char& c : s) c = "abc"[gen() % 3];
+        return s;
+    };
+    for (int i = 0; i < 300; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i);
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, randomString(8), randomString(5), "K", i, i));
+    }
+    // the n-grams of modified names and authors are updated
+    for (int i = 0; i < 300; i += 3) {
+        const auto ISBN = util::toArray<Book::ISBN_T>("ISBN" + std::to_string(i));
+        Book book = manager.getBooksWithISBN(ISBN)[0];
+        book.book_name = util::toArray<Book::BOOKNAME_T>(randomString(8));
+        if (i % 2) book.author = util::toArray<Book::AUTHOR_T>(randomString(5));
+        manager.modifyBookData(ISBN, book);
+    }
+    const auto all = manager.getAllBooks();
+    for (int i = 0; i < 100; i++) {
+        BookQuery query;
+        const std::string name = randomString(5), author = randomString(3);
+        query.name_contains = util::toArray<Book::BOOKNAME_T>(name);
+        if (i % 2) query.author_contains = util::toArray<Book::AUTHOR_T>(author);
+        std::vector<Book> expected;
+        for (const auto& book : all) {
+            if (util::toString(book.book_name).find(name) == std::string::npos) continue;
+            if (i % 2 && util::toString(book.author).find(author) == std::string::npos) continue;
+            expected.push_back(book);
+        }
+        std::vector<Book> result;
+        manager.forEachBookMatching(query, [&result](const Book& book) { result.push_back(book); });
+        REQUIRE(result == expected);
+    }
+}
+
+TEST_CASE("BooksManager Price And Quantity Ranges", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    std::mt19937 gen{998244353};
+    for (int i = 0; i < 300; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i);
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N", "A", "K", gen() % 50, gen() % 10000));
+    }
+    // the quantities change through import, buy and modify
+    for (int i = 0; i < 600; i++) {
+        const auto ISBN = util::toArray<Book::ISBN_T>("ISBN" + std::to_string(gen() % 300));
+        if (i % 3 == 0) {
+            manager.importBook(ISBN, gen() % 20 + 1);
+        } else if (i % 3 == 1) {
+            manager.buyBook(ISBN, gen() % 20 + 1);
+        } else {
+            Book book = manager.getBooksWithISBN(ISBN)[0];
+            book.quantity = gen() % 50;
+            book.price = gen() % 10000;
+            manager.modifyBookData(ISBN, book);
+        }
+    }
+    const auto all = manager.getAllBooks();
+    for (int i = 0; i < 100; i++) {
+        BookQuery query;
+        if (i % 4 != 0) query.min_price = gen() % 10000;
+        if (i % 4 != 1) query.max_price = gen() % 10000;
+        if (i % 2) query.max_quantity = gen() % 10;  // a low-stock sweep
+        if (i % 5 == 0) query.min_quantity = gen() % 60;
+        std::vector<Book> expected;
+        for (const auto& book : all) {
+            if (book.price < query.min_price.value_or(0)) continue;
+            if (book.price > query.max_price.value_or(1LL << 62)) continue;
+            if (book.quantity < query.min_quantity.value_or(0)) continue;
+            if (book.quantity > query.max_quantity.value_or(1 << 30)) continue;
+            expected.push_back(book);
+        }
+        std::vector<Book> result;
+        manager.forEachBookMatching(query, [&result](const Book& book) { result.push_back(book); });
+        REQUIRE(result == expected);
+    }
+}
+
+TEST_CASE("BooksManager Pagination With Cursor", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    for (int i = 0; i < 500; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i * 7919 % 500);
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        // K1 matches most books, and K2 only a few, so both ways of ordering the ids are paged
+        const std::string keywords = i % 50 == 0 ? "K1|K2" : "K1";
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N", "A", keywords, i, i));
+    }
+    for (const char* keyword : {"", "K1", "K2"}) {
+        BookQuery query;
+        if (*keyword) query.keywords.push_back(util::toArray<Book::KEYWORD_T>(keyword));
+        std::vector<Book> expected, result;
+        manager.forEachBookMatching(query,
+                                    [&expected](const Book& book) { expected.push_back(book); });
+        for (const size_t limit : {1, 3, 37, 1000}) {
+            result.clear();
+            BookPage page{std::nullopt, limit};
+            bool has_more = true;
+            while (has_more) {
+                const size_t size = result.size();
+                has_more = manager.forEachBookMatching(
+                    query, [&result](const Book& book) { result.push_back(book); }, page);
+                REQUIRE(result.size() - size <= limit);
+                if (has_more) {
+                    REQUIRE(result.size() - size == limit);
+                    page.after = result.back().ISBN;
+                }
+            }
+            REQUIRE(result == expected);
+        }
+    }
+}
+
+TEST_CASE("BooksManager Concurrent Queries And Updates", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    const int N = 200, READERS = 4, ROUNDS = 1000;
+    for (int i = 0; i < N; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i);
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N", "A", "K", 100, 100));
+    }
+    // the writers keep the price of every book equal to its quantity, and add books without K
+    std::atomic<bool> done = false;
+    std::atomic<int> bad_results = 0;
+    std::vector<std::thread> threads;
+    threads.emplace_back([&manager] {
+        std::mt19937 gen{42};
+        for (int i = 0; i < ROUNDS; i++) {
+            const auto ISBN = util::toArray<Book::ISBN_T>("ISBN" + std::to_string(gen() % N));
+            Book book = manager.getBooksWithISBN(ISBN).front();
+            book.quantity++;
+            book.price++;
+            manager.modifyBookData(ISBN, book);
+        }
+    });
+    threads.emplace_back([&manager] {
+        for (int i = 0; i < ROUNDS; i++) {
+            const std::string ISBN = "NEW" + std::to_string(i);
+            manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        }
+    });
+    for (int t = 0; t < READERS; t++) {
+        threads.emplace_back([&manager, &done, &bad_results] {
+            BookQuery query;
+            query.keywords.push_back(util::toArray<Book::KEYWORD_T>("K"));
+            query.min_quantity = 100;
+            while (!done) {
+                int count = 0;
+                manager.forEachBookMatching(query, [&count, &bad_results](const Book& book) {
+                    ++count;
+                    if (book.price != book.quantity) ++bad_results;
+                });
+                if (count != N) ++bad_results;
+            }
+        });
+    }
+    threads[0].join();
+    threads[1].join();
+    done = true;
+    for (int t = 0; t < READERS; t++) threads[2 + t].join();
+    REQUIRE(bad_results == 0);
+    REQUIRE(manager.getAllBooks().size() == N + ROUNDS);
+    long long total = 0;
+    manager.forEachBookWithKeyword(util::toArray<Book::KEYWORD_T>("K"),
+                                   [&total](const Book& book) { total += book.quantity; });
+    REQUIRE(total == 100LL * N + ROUNDS);
+}
+
+TEST_CASE("BooksManager Snapshot Lookups", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    for (int i = 0; i < 100; i++) {
+        const std::string ISBN = "ISBN" + std::to_string(i);
+        manager.createBook(util::toArray<Book::ISBN_T>(ISBN));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(ISBN),
+                               gen_book(ISBN, "N" + std::to_string(i), "A", "K", i, i));
+    }
+    // the books before and after enabling the snapshots are both published
+    manager.enableSnapshots();
+    manager.createBook(util::toArray<Book::ISBN_T>("NEW"));
+    std::mt19937 gen{2026};
+    for (int i = 0; i < 1000; i++) {
+        const auto ISBN = util::toArray<Book::ISBN_T>("ISBN" + std::to_string(gen() % 100));
+        switch (gen() % 3) {
+            case 0:
+                manager.importBook(ISBN, 5);
+                break;
+            case 1:
+                manager.buyBook(ISBN, 3);
+                break;
+            default:
+                Book book = manager.getBooksWithISBN(ISBN).front();
+                book.price = gen() % 1000;
+                book.keywords = util::toArray<Book::KEYWORD_T>(gen() % 2 ? "K" : "K|L");
+                manager.modifyBookData(ISBN, book);
+        }
+    }
+    manager.modifyBookData(util::toArray<Book::ISBN_T>("ISBN7"),
+                           gen_book("MOVED", "N7", "A", "K", 7, 7));
+    REQUIRE(manager.getBooksWithISBN(util::toArray<Book::ISBN_T>("ISBN7")).empty());
+    // the books read from disk agree with the snapshots
+    int count = 0;
+    manager.forEachBookWithAuthor(util::toArray<Book::AUTHOR_T>("A"), [&](const Book& book) {
+        ++count;
+        REQUIRE(manager.getBooksWithISBN(book.ISBN) == std::vector<Book>{book});
+    });
+    REQUIRE(count == 100);
+    BookQuery query;
+    query.ISBN = util::toArray<Book::ISBN_T>("NEW");
+    std::vector<Book> result;
+    REQUIRE_FALSE(
+        manager.forEachBookMatching(query, [&result](const Book& book) { result.push_back(book); }));
+    REQUIRE(result.size() == 1);
+    REQUIRE(manager.forEachBookMatching(query, [](const Book&) {}, BookPage{std::nullopt, 0}));
+    REQUIRE_FALSE(manager.forEachBookMatching(query, [](const Book&) { FAIL(); },
+                                              BookPage{query.ISBN, 10}));
+}
+
+TEST_CASE("BooksManager Concurrent Purchases", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    const auto ISBN = util::toArray<Book::ISBN_T>("SALE");
+    manager.createBook(ISBN);
+    manager.modifyBookData(ISBN, gen_book("SALE", "N", "A", "K", 1000, 25));
+    REQUIRE(manager.tryBuy(util::toArray<Book::ISBN_T>("NONE"), 1).status == Purchase::NO_BOOK);
+    const Purchase failed = manager.tryBuy(ISBN, 1001);
+    REQUIRE(failed.status == Purchase::OUT_OF_STOCK);
+    REQUIRE(failed.quantity == 1000);
+
+    // more copies are asked for than there are, and each one is sold exactly once
+    const int THREADS = 8;
+    std::atomic<int> sold = 0, bad_results = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&manager, &ISBN, &sold, &bad_results, t] {
+            std::mt19937 gen(t);
+            for (int i = 0; i < 200; i++) {
+                const int quantity = gen() % 3 + 1;
+                const Purchase purchase = manager.tryBuy(ISBN, quantity);
+                if (purchase.price != 25 || purchase.quantity < 0) ++bad_results;
+                if (purchase.status == Purchase::SUCCESS) sold += quantity;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    REQUIRE(bad_results == 0);
+    const int left = manager.getBooksWithISBN(ISBN).front().quantity;
+    REQUIRE(sold + left == 1000);
+    REQUIRE(left < 3);
+    BookQuery query;
+    query.max_quantity = left;
+    std::vector<Book> result;
+    manager.forEachBookMatching(query, [&result](const Book& book) { result.push_back(book); });
+    REQUIRE(result.size() == 1);
+
+    // purchases of different books run in parallel, and keep quantity_index consistent
+    const int BOOKS = 4;
+    for (int b = 0; b < BOOKS; b++) {
+        const std::string isbn = "STRIPE" + std::to_string(b);
+        manager.createBook(util::toArray<Book::ISBN_T>(isbn));
+        manager.modifyBookData(util::toArray<Book::ISBN_T>(isbn),
+                               gen_book(isbn, "N", "A", "K", 10000 + b, 10));
+    }
+    threads.clear();
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&manager, t] {
+            for (int i = 0; i < 500; i++) {
+                const int b = (t + i) % BOOKS;
+                manager.tryBuy(util::toArray<Book::ISBN_T>("STRIPE" + std::to_string(b)), 1);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (int b = 0; b < BOOKS; b++) {
+        BookQuery stock;
+        stock.min_quantity = stock.max_quantity = 10000 + b - THREADS * 500 / BOOKS;
+        std::vector<Book> books;
+        manager.forEachBookMatching(stock, [&books](const Book& book) { books.push_back(book); });
+        REQUIRE(books.size() == 1);
+        REQUIRE(util::toString(books.front().ISBN) == "STRIPE" + std::to_string(b));
+    }
+}
+
+TEST_CASE("BooksManager Reads During Purchases", "[BooksManager]") {
+    auto& manager = BooksManager::getInstance();
+    manager.reset();
+    const auto ISBN = util::toArray<Book::ISBN_T>("SALE");
+    manager.createBook(ISBN);
+    manager.modifyBookData(ISBN, gen_book("SALE", "N", "A", "K", 100000, 25));
+
+    // the whole record is read while purchases update its quantity in place, without a
+    // WriteAheadLog holding the writes back
+    const int BUYERS = 4, READERS = 4, N = 2000;
+    std::atomic<bool> done = false;
+    std::atomic<int> bad_reads = 0;
+    std::vector<std::thread> readers, buyers;
+    for (int t = 0; t < READERS; t++) {
+        readers.emplace_back([&manager, &done, &bad_reads] {
+            int last = 100000;
+            while (!done) {
+                manager.forEachBook([&last, &bad_reads](const Book& book) {
+                    if (util::toString(book.ISBN) != "SALE" || book.price != 25) ++bad_reads;
+                    if (book.quantity > last) ++bad_reads;
+                    last = book.quantity;
+                });
+            }
+        });
+    }
+    for (int t = 0; t < BUYERS; t++) {
+        buyers.emplace_back([&manager, &ISBN] {
+            for (int i = 0; i < N; i++) manager.tryBuy(ISBN, 1);
+        });
+    }
+    for (auto& thread : buyers) thread.join();
+    done = true;
+    for (auto& thread : readers) thread.join();
+    REQUIRE(bad_reads == 0);
+    REQUIRE(manager.getBooksWithISBN(ISBN).front().quantity == 100000 - BUYERS * N);
+}
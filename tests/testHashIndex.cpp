@@ -0,0 +1,77 @@
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "HashIndex.hpp"
+#include "MappedFile.hpp"
+
+TEST_CASE("HashIndex Basic Operations", "[HashIndex]") {
+    std::filesystem::remove("data");
+    HashIndex<int, int> index;
+    index.initialise("data");
+    REQUIRE(!index.find(1).has_value());
+    REQUIRE(index.insert(1, 10));
+    REQUIRE(index.insert(2, 20));
+    REQUIRE(!index.insert(1, 30));  // the key already exists
+    REQUIRE(index.find(1) == 10);
+    REQUIRE(index.find(2) == 20);
+    REQUIRE(index.update(2, 25));
+    REQUIRE(!index.update(3, 30));  // the key doesn't exist
+    REQUIRE(index.find(2) == 25);
+    REQUIRE(index.size() == 2);
+    REQUIRE(index.erase(1));
+    REQUIRE(!index.erase(1));
+    REQUIRE(!index.contains(1));
+    REQUIRE(index.contains(2));
+    REQUIRE(index.size() == 1);
+}
+
+TEST_CASE("HashIndex Massive Insert With Reopen", "[HashIndex]") {
+    std::filesystem::remove("data");
+    const int N = 100000;
+    {
+        HashIndex<int, int, MappedFile> index;
+        index.initialise("data");
+        for (int i = 0; i < N; i++) REQUIRE(index.insert(i * 7919, i));
+    }
+    HashIndex<int, int, MappedFile> index;
+    index.initialise("data");
+    REQUIRE(index.size() == N);
+    for (int i = 0; i < N; i++) REQUIRE(index.find(i * 7919) == i);
+    REQUIRE(!index.contains(1));
+}
+
+TEST_CASE("HashIndex Random Operations With Reopen", "[HashIndex]") {
+    std::filesystem::remove("data");
+    // a large value makes the buckets small, so that overflow chains appear often
+    using Value = std::array<int, 150>;
+    std::map<int, Value> reference;
+    std::mt19937 gen{1919810};
+    for (int round = 0; round < 6; round++) {
+        HashIndex<int, Value> index;
+        index.initialise("data");
+        const int insert_weight = round < 3 ? 3 : 1;
+        for (int i = 0; i < 5000; i++) {
+            const int key = gen() % 3000;
+            if (gen() % (insert_weight + 1)) {
+                Value value{};
+                value[0] = value[149] = gen();
+                REQUIRE(index.insert(key, value) == !reference.contains(key));
+                reference.emplace(key, value);
+            } else {
+                REQUIRE(index.erase(key) == reference.contains(key));
+                reference.erase(key);
+            }
+        }
+        REQUIRE(index.size() == reference.size());
+        for (int key = 0; key < 3000; key++) {
+            auto it = reference.find(key);
+            auto result = index.find(key);
+            REQUIRE(result.has_value() == (it != reference.end()));
+            if (result) REQUIRE(*result == it->second);
+        }
+    }
+}
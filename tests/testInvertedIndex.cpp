@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "InvertedIndex.hpp"
+#include "MappedFile.hpp"
+
+namespace {
+void removeFiles() {
+    std::filesystem::remove("data");
+    std::filesystem::remove("data_postings");
+}
+std::vector<int> toVector(const std::set<int>& ids) { return {ids.begin(), ids.end()}; }
+}  // namespace
+
+TEST_CASE("InvertedIndex Basic Operations", "[InvertedIndex]") {
+    removeFiles();
+    InvertedIndex<int> index;
+    index.initialise("data");
+    REQUIRE(index.query(1).empty());
+    index.insert(1, 5);
+    index.insert(1, 5);  // already exists
+    REQUIRE(index.query(1) == std::vector<int>{5});
+    for (int id = 100; id > 5; id--) index.insert(1, id);
+    REQUIRE(index.count(1) == 96);
+    for (int id = 5; id <= 100; id++) REQUIRE(index.query(1)[id - 5] == id);
+    index.insert(2, 50);
+    index.insert(2, 7);
+    index.insert(3, 1);
+    REQUIRE(index.query({1, 2}, {}) == std::vector<int>{7, 50});
+    REQUIRE(index.query({}, {2, 3}) == std::vector<int>{1, 7, 50});
+    REQUIRE(index.query({1}, {2, 3}, {3}) == std::vector<int>{7, 50});
+    REQUIRE(index.query({1}, {}, {2}).size() == 94);
+    REQUIRE(index.query({1, 4}, {}).empty());
+    for (int id = 6; id <= 100; id++) index.erase(1, id);
+    index.erase(1, 1000);  // doesn't exist
+    REQUIRE(index.query(1) == std::vector<int>{5});
+    index.erase(1, 5);
+    REQUIRE(index.count(1) == 0);
+}
+
+TEST_CASE("InvertedIndex Random Operations With Reopen", "[InvertedIndex]") {
+    removeFiles();
+    std::map<int, std::set<int>> reference;
+    std::mt19937 gen{20260101};
+    for (int round = 0; round < 6; round++) {
+        InvertedIndex<int, MappedFile> index;
+        index.initialise("data");
+        const int insert_weight = round < 3 ? 3 : 1;
+        for (int i = 0; i < 20000; i++) {
+            // a few keys have long lists, and the gaps between ids vary a lot
+            const int key = gen() % 4 ? gen() % 5 : gen() % 200;
+            const int id = gen() % 2 ? gen() % 3000 + 1 : gen() % 1000000 + 1;
+            if (gen() % (insert_weight + 1)) {
+                index.insert(key, id);
+                reference[key].insert(id);
+            } else {
+                index.erase(key, id);
+                reference[key].erase(id);
+            }
+        }
+        for (int key = 0; key < 200; key++) {
+            REQUIRE(index.query(key) == toVector(reference[key]));
+            REQUIRE(index.count(key) == reference[key].size());
+        }
+        // boolean queries are compared with the results of set operations
+        for (int i = 0; i < 200; i++) {
+            std::vector<int> all_of, any_of, none_of;
+            for (int j = gen() % 3; j > 0; j--) all_of.push_back(gen() % 8);
+            for (int j = gen() % 3 + all_of.empty(); j > 0; j--) any_of.push_back(gen() % 8);
+            for (int j = gen() % 3; j > 0; j--) none_of.push_back(gen() % 8);
+            std::set<int> candidates;
+            for (const auto& [key, ids] : reference) candidates.insert(ids.begin(), ids.end());
+            std::vector<int> expected;
+            for (const int id : candidates) {
+                auto in = [&reference, id](int key) { return reference[key].contains(id); };
+                if (std::ranges::all_of(all_of, in) &&
+                    (any_of.empty() || std::ranges::any_of(any_of, in)) &&
+                    std::ranges::none_of(none_of, in)) {
+                    expected.push_back(id);
+                }
+            }
+            REQUIRE(index.query(all_of, any_of, none_of) == expected);
+        }
+    }
+}
+
+TEST_CASE("InvertedIndex Bulk Load", "[InvertedIndex]") {
+    removeFiles();
+    std::vector<std::pair<int, int>> pairs;
+    std::map<int, std::set<int>> reference;
+    std::mt19937 gen{42};
+    for (int key = 0; key < 100; key++) {
+        // one key out of ten has a single id
+        const int n = key % 10 ? gen() % 2000 + 2 : 1;
+        for (int i = 0; i < n; i++) reference[key].insert(gen() % 100000 + 1);
+        for (const int id : reference[key]) pairs.emplace_back(key, id);
+    }
+    {
+        InvertedIndex<int, MappedFile> index;
+        index.initialise("data");
+        index.bulkLoad(pairs);
+    }
+    InvertedIndex<int, MappedFile> index;
+    index.initialise("data");
+    for (int key = 0; key < 100; key++) REQUIRE(index.query(key) == toVector(reference[key]));
+    // the bulk-loaded lists can be modified as usual
+    for (int key = 0; key < 100; key++) {
+        const int id = gen() % 100000 + 1;
+        index.insert(key, id);
+        reference[key].insert(id);
+        const int erased = *reference[key].begin();
+        index.erase(key, erased);
+        reference[key].erase(erased);
+        REQUIRE(index.query(key) == toVector(reference[key]));
+    }
+}
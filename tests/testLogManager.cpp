@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "LogManager.hpp"
+#include "Utils.hpp"
+
+TEST_CASE("LogManager Finance Totals", "[LogManager]") {
+    LogManager& manager = LogManager::getInstance();
+    const auto userid = util::toArray<User::USERID_T>("root");
+    const auto [income_before, expense_before] = manager.getFinanceValue();
+
+    std::vector<long long> values;
+    std::mt19937 gen{114514};
+    for (int i = 0; i < 200; i++) {
+        values.push_back(static_cast<long long>(gen() % 2001) - 1000);
+        manager.addFinanceLog(i, userid, values.back());
+    }
+    // the sums of the last cnt values
+    auto expected = [&values](int cnt) {
+        long long income = 0, expense = 0;
+        for (int i = values.size() - cnt; i < values.size(); i++) {
+            (values[i] > 0 ? income : expense) += std::abs(values[i]);
+        }
+        return std::make_pair(income, expense);
+    };
+    auto check = [&] {
+        for (int cnt : {1, 2, 17, 200}) {
+            REQUIRE(manager.getFinanceValue(cnt) == expected(cnt));
+        }
+        const auto [income, expense] = expected(200);
+        REQUIRE(manager.getFinanceValue() ==
+                std::make_pair(income_before + income, expense_before + expense));
+    };
+    check();
+    manager.rebuildFinanceTotals();
+    check();
+    REQUIRE_THROWS_AS(manager.getFinanceValue(manager.getFinanceLogCount() + 1), std::out_of_range);
+}
+
+TEST_CASE("LogManager Asynchronous Operation Log", "[LogManager]") {
+    LogManager& manager = LogManager::getInstance();
+    const auto userid = util::toArray<User::USERID_T>("async_user");
+    const int count_before = manager.getOperationLogCount();
+    manager.setAsyncOperationLog(true);
+    // more entries than the buffer holds, so that the producer has to wait for the writer
+    const int N = 3000;
+    std::vector<int> ids;
+    for (int i = 0; i < N; i++) {
+        ids.push_back(manager.addOperationLog(
+            i, userid, 1, Log::Operation(Log::OpCode::SHOW_FINANCE).add(Log::Field::COUNT, i)));
+        if (i % 2 == 0) manager.markOperationSuccess(ids.back());
+    }
+    REQUIRE(manager.getOperationLogCount() == count_before + N);
+    for (int i = 0; i < N; i++) {
+        REQUIRE(ids[i] == count_before + i + 1);
+        const OperationLogEntry entry = manager.getOperationLogEntry(ids[i]);
+        REQUIRE(entry.timestamp == i);
+        REQUIRE(entry.op.toString() == "show finance -count=" + std::to_string(i));
+        REQUIRE(entry.is_success == (i % 2 == 0));
+    }
+    // marking an entry that has been written
+    manager.markOperationSuccess(ids[1]);
+    manager.setAsyncOperationLog(false);
+    REQUIRE(manager.getOperationLogEntry(ids[1]).is_success);
+    int indexed = 0;
+    manager.forEachOperationLogByUser(
+        [&](const OperationLogEntry& entry) { indexed += entry.userid == userid; });
+    REQUIRE(indexed == N);
+}
+
+TEST_CASE("LogManager Concurrent Purchases And Imports", "[LogManager]") {
+    LogManager& manager = LogManager::getInstance();
+    const auto userid = util::toArray<User::USERID_T>("concurrent_user");
+    const int finance_before = manager.getFinanceLogCount();
+    const auto [income_before, expense_before] = manager.getFinanceValue();
+    const int operations_before = manager.getOperationLogCount();
+    // each thread buys (income) and imports (expense) as the commands do
+    const int THREADS = 8, N = 200;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> ids(THREADS);
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < N; i++) {
+                const bool buy = i % 2 == 0;
+                ids[t].push_back(manager.addOperationLog(
+                    t, userid, 3, Log::Operation(buy ? Log::OpCode::BUY : Log::OpCode::IMPORT)));
+                manager.addFinanceLog(t, userid, buy ? t + 1 : -(t + 1));
+                manager.markOperationSuccess(ids[t].back());
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    const int total = THREADS * N;
+    REQUIRE(manager.getFinanceLogCount() == finance_before + total);
+    long long income = 0, expense = 0;
+    for (int t = 0; t < THREADS; t++) {
+        income += (t + 1) * (N / 2);
+        expense += (t + 1) * (N / 2);
+    }
+    REQUIRE(manager.getFinanceValue(total) == std::make_pair(income, expense));
+    REQUIRE(manager.getFinanceValue() ==
+            std::make_pair(income_before + income, expense_before + expense));
+    // the running totals agree with the entries
+    manager.rebuildFinanceTotals();
+    REQUIRE(manager.getFinanceValue(total) == std::make_pair(income, expense));
+
+    REQUIRE(manager.getOperationLogCount() == operations_before + total);
+    for (int t = 0; t < THREADS; t++) {
+        for (const int id : ids[t]) {
+            const OperationLogEntry entry = manager.getOperationLogEntry(id);
+            REQUIRE(entry.timestamp == t);
+            REQUIRE(entry.is_success);
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "BlockList.hpp"
+#include "MappedFile.hpp"
+#include "MemoryRiver.hpp"
+
+TEST_CASE("MappedFile Read/Write And Growth", "[MappedFile]") {
+    std::filesystem::remove("tmp_file");
+    const int N = 3 * MappedFile::GROW_CHUNK + 123;
+    std::vector<char> data(N);
+    std::mt19937 gen{114514};
+    for (auto& c : data) c = static_cast<char>(gen());
+    {
+        MappedFile file;
+        file.open("tmp_file");
+        for (int pos = 0; pos < N; pos += 1000) {
+            file.write(data.data() + pos, pos, std::min(1000, N - pos));
+        }
+        std::vector<char> result(N);
+        file.read(result.data(), 0, N);
+        REQUIRE(result == data);
+        REQUIRE(file.size() == N);
+    }
+    // the file is truncated to the data written on close
+    REQUIRE(std::filesystem::file_size("tmp_file") == N);
+    {
+        MappedFile file;
+        file.open("tmp_file");
+        std::vector<char> result(N);
+        file.read(result.data(), 0, N);
+        REQUIRE(result == data);
+        int tmp = -1;
+        file.read(reinterpret_cast<char*>(&tmp), N, sizeof(int));
+        REQUIRE(tmp == 0);
+    }
+}
+
+TEST_CASE("MemoryRiver With MappedFile", "[MemoryRiver]") {
+    std::filesystem::remove("tmp_file");
+    struct Data {
+        int x, y;
+    };
+    const int N = 100000;
+    std::vector<int> pos;
+    {
+        MemoryRiver<Data, 1, MappedFile> mr("tmp_file");
+        mr.initialise();
+        for (int i = 0; i < N; i++) {
+            pos.push_back(mr.write(Data{i, -i}));
+        }
+        for (int i = 0; i < N; i += 2) {
+            mr.update(i * 2, pos[i], offsetof(Data, y));
+        }
+        mr.writeInfo(N, 1);
+    }
+    {
+        MemoryRiver<Data, 1, MappedFile> mr("tmp_file");
+        mr.initialise();
+        int tmp;
+        mr.getInfo(tmp, 1);
+        REQUIRE(tmp == N);
+        for (int i = 0; i < N; i++) {
+            Data data;
+            mr.read(data, pos[i]);
+            REQUIRE(data.x == i);
+            REQUIRE(data.y == (i % 2 ? -i : i * 2));
+        }
+    }
+}
+
+TEST_CASE("BlockList With MappedFile", "[BlockList]") {
+    std::filesystem::remove("data");
+    std::vector<unsigned> data;
+    const int N = 10000;
+    std::mt19937 gen{14514};
+    for (int i = 0; i < N; i++) {
+        data.push_back(gen());
+    }
+    {
+        BlockList<int, unsigned, MappedFile> blocklist;
+        blocklist.initialise("data");
+        for (auto v : data) blocklist.insert(v % 7, v);
+    }
+    {
+        BlockList<int, unsigned, MappedFile> blocklist;
+        blocklist.initialise("data");
+        for (int key = 0; key < 7; key++) {
+            std::vector<unsigned> expected;
+            for (auto v : data) {
+                if (v % 7 == key) expected.push_back(v);
+            }
+            std::ranges::sort(expected);
+            REQUIRE(blocklist.query(key) == expected);
+        }
+    }
+}
+
+TEST_CASE("MappedFile Concurrent Access", "[MappedFile]") {
+    std::filesystem::remove("tmp_file");
+    // the writers grow the file by several chunks, so it is remapped under the readers
+    const int THREADS = 4, BLOCK = 1000, BLOCKS = 4 * MappedFile::GROW_CHUNK / BLOCK;
+    MappedFile file;
+    file.open("tmp_file");
+    const std::vector<char> head(BLOCK, 'x');
+    file.write(head.data(), 0, BLOCK);
+    std::atomic<int> bad_reads = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&file, t] {
+            const std::vector<char> block(BLOCK, static_cast<char>('a' + t));
+            for (int i = 1 + t; i < BLOCKS; i += THREADS) {
+                file.write(block.data(), 1LL * i * BLOCK, BLOCK);
+            }
+        });
+        threads.emplace_back([&file, &bad_reads] {
+            std::vector<char> block(BLOCK);
+            for (int i = 0; i < 2000; i++) {
+                file.read(block.data(), 0, BLOCK);
+                if (std::ranges::count(block, 'x') != BLOCK) ++bad_reads;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    REQUIRE(bad_reads == 0);
+    REQUIRE(file.size() == 1LL * BLOCKS * BLOCK);
+    std::vector<char> block(BLOCK);
+    for (int i = 1; i < BLOCKS; i++) {
+        file.read(block.data(), 1LL * i * BLOCK, BLOCK);
+        REQUIRE(std::ranges::count(block, 'a' + (i - 1) % THREADS) == BLOCK);
+    }
+}
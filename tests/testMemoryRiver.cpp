@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include "MemoryRiver.hpp"
@@ -75,11 +77,13 @@ TEST_CASE("MemoryRiver Persistent Read/Write", "[MemoryRiver]") {
         for (int i = 0; i < N; i++) {
             pos[i] = mr.write(data[i]);
         }
+        REQUIRE(mr.getCount() == N);
     } while (false);
 
     do {
         MemoryRiver<int> mr("tmp_file");
         mr.initialise();
+        REQUIRE(mr.getCount() == N);
         for (int i = 0; i < N; i++) {
             int x;
             mr.read(x, pos[i]);
@@ -212,4 +216,35 @@ TEST_CASE("MemoryRiver Partial Read&Write", "[MemoryRiver]") {
         REQUIRE(res.x == i * i * i);
         REQUIRE(res.y == i * i);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("MemoryRiver Concurrent Allocation", "[MemoryRiver]") {
+    std::filesystem::remove("tmp_file");
+    const int THREADS = 4, N = 5000;
+    MemoryRiver<long long, 1> mr("tmp_file");
+    mr.initialise();
+    // half of the slots are taken from the free list, and the rest are new
+    std::vector<int> erased;
+    for (int i = 0; i < THREADS * N / 2; i++) erased.push_back(mr.write(0));
+    for (const int index : erased) mr.erase(index);
+
+    std::vector<std::vector<int>> pos(THREADS);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&mr, &pos, t] {
+            for (int i = 0; i < N; i++) pos[t].push_back(mr.write(1LL * t * N + i));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    std::vector<int> all;
+    for (int t = 0; t < THREADS; t++) {
+        for (int i = 0; i < N; i++) {
+            long long val;
+            mr.read(val, pos[t][i]);
+            REQUIRE(val == 1LL * t * N + i);
+            all.push_back(pos[t][i]);
+        }
+    }
+    std::ranges::sort(all);
+    REQUIRE(std::ranges::adjacent_find(all) == all.end());
+    REQUIRE(all.back() == THREADS * N);
+}
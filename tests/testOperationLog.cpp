@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "OperationLog.hpp"
+#include "Utils.hpp"
+
+TEST_CASE("Operation Encoding", "[OperationLog]") {
+    Log::Operation buy(Log::OpCode::BUY);
+    buy.add(Log::Field::ISBN, "978-7").add(Log::Field::QUANTITY, 3);
+    REQUIRE(buy.toString() == "buy -ISBN=978-7 -quantity=3");
+    REQUIRE(buy.data().size() < 16);
+    REQUIRE(Log::Operation::fromData(buy.data()).toString() == buy.toString());
+
+    Log::Operation modify(Log::OpCode::MODIFY);
+    modify.add(Log::Field::NAME, "").add(Log::Field::PRICE, 1234567890123LL);
+    REQUIRE(modify.toString() == "modify -name= -price=1234567890123");
+    Log::Operation import(Log::OpCode::IMPORT);
+    import.add(Log::Field::QUANTITY, -1).add(Log::Field::TOTAL_COST, -9223372036854775807LL - 1);
+    REQUIRE(import.toString() == "import -quantity=-1 -total_cost=-9223372036854775808");
+
+    REQUIRE(Log::Operation(Log::OpCode::REPORT_EMPLOYEE).toString() == "report employee");
+    Log::Operation legacy(Log::OpCode::LEGACY);
+    legacy.add(Log::Field::TEXT, "su -user=root -password=sjtu");
+    REQUIRE(legacy.toString() == "su -user=root -password=sjtu");
+}
+
+TEST_CASE("OperationLogFile Random Access With Reopen", "[OperationLog]") {
+    std::filesystem::remove("data");
+    std::filesystem::remove("data_index");
+    std::mt19937 gen{114514};
+    std::vector<OperationLogEntry> reference;
+    for (int round = 0; round < 4; round++) {
+        if (round == 2) {
+            // an index as written before its entries were appended, with no slot allocated
+            std::fstream index("data_index", std::ios::binary | std::ios::in | std::ios::out);
+            const int allocated = 0;
+            index.write(reinterpret_cast<const char*>(&allocated), sizeof(allocated));
+        }
+        OperationLogFile log;
+        log.open("data", "data_index");
+        REQUIRE(log.size() == reference.size());
+        // appends in batches of different sizes
+        for (int batch = 0; batch < 50; batch++) {
+            std::vector<OperationLogEntry> entries(gen() % 20 + 1);
+            for (auto& entry : entries) {
+                entry.timestamp = gen();
+                entry.userid = util::toArray<User::USERID_T>("user" + std::to_string(gen() % 100));
+                entry.user_privilege = gen() % 2 ? 7 : -1;
+                entry.op = Log::Operation(Log::OpCode::SHOW);
+                entry.op.add(Log::Field::KEYWORD, std::string(gen() % 61, 'k'));
+                entry.is_success = 0;
+            }
+            log.append(entries.data(), entries.size());
+            reference.insert(reference.end(), entries.begin(), entries.end());
+        }
+        for (int i = 0; i < 300; i++) {
+            const int id = gen() % reference.size() + 1;
+            log.markSuccess(id);
+            reference[id - 1].is_success = 1;
+        }
+        // in order, then randomly
+        std::vector<int> ids;
+        for (int id = 1; id <= reference.size(); id++) ids.push_back(id);
+        for (int i = 0; i < 1000; i++) ids.push_back(gen() % reference.size() + 1);
+        for (int id : ids) {
+            const OperationLogEntry entry = log.read(id);
+            const OperationLogEntry& expected = reference[id - 1];
+            REQUIRE(entry.timestamp == expected.timestamp);
+            REQUIRE(entry.userid == expected.userid);
+            REQUIRE(entry.user_privilege == expected.user_privilege);
+            REQUIRE(entry.op.data() == expected.op.data());
+            REQUIRE(entry.is_success == expected.is_success);
+        }
+    }
+}
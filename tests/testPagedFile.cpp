@@ -0,0 +1,144 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "MemoryRiver.hpp"
+#include "PagedFile.hpp"
+
+TEST_CASE("PagedFile Read/Write Across Pages", "[PagedFile]") {
+    std::filesystem::remove("tmp_file");
+    const int N = 5 * PagedFile::PAGE_SIZE;
+    std::vector<char> data(N);
+    std::mt19937 gen{114514};
+    for (auto& c : data) c = static_cast<char>(gen());
+    {
+        PagedFile file;
+        file.open("tmp_file");
+        file.setCacheCapacity(2 * PagedFile::PAGE_SIZE);
+        // write in chunks that are not aligned to pages
+        for (int pos = 0; pos < N; pos += 1000) {
+            file.write(data.data() + pos, pos, std::min(1000, N - pos));
+        }
+        std::vector<char> result(N);
+        file.read(result.data(), 0, N);
+        REQUIRE(result == data);
+        REQUIRE(file.size() == N);
+    }
+    REQUIRE(std::filesystem::file_size("tmp_file") == N);
+    {
+        PagedFile file;
+        file.open("tmp_file");
+        std::vector<char> result(N);
+        file.read(result.data(), 0, N);
+        REQUIRE(result == data);
+    }
+}
+
+TEST_CASE("PagedFile Write Back", "[PagedFile]") {
+    std::filesystem::remove("tmp_file");
+    PagedFile file;
+    file.open("tmp_file");
+    file.setCacheCapacity(4 * PagedFile::PAGE_SIZE);
+    const int val = 114514;
+    file.write(reinterpret_cast<const char*>(&val), 100, sizeof(int));
+    // the modification stays in memory until flushed
+    REQUIRE(std::filesystem::file_size("tmp_file") == 0);
+    file.flush();
+    REQUIRE(std::filesystem::file_size("tmp_file") == 100 + sizeof(int));
+
+    // reading beyond the end of file yields zeroes
+    int tmp = -1;
+    file.read(reinterpret_cast<char*>(&tmp), 10 * PagedFile::PAGE_SIZE, sizeof(int));
+    REQUIRE(tmp == 0);
+}
+
+TEST_CASE("PagedFile Hit And Miss Counters", "[PagedFile]") {
+    std::filesystem::remove("tmp_file");
+    PagedFile file;
+    file.open("tmp_file");
+    file.setCacheCapacity(2 * PagedFile::PAGE_SIZE);
+    int tmp;
+    file.read(reinterpret_cast<char*>(&tmp), 0, sizeof(int));
+    file.read(reinterpret_cast<char*>(&tmp), 4, sizeof(int));
+    REQUIRE(file.getCacheMisses() == 1);
+    REQUIRE(file.getCacheHits() == 1);
+
+    file.read(reinterpret_cast<char*>(&tmp), PagedFile::PAGE_SIZE, sizeof(int));
+    file.read(reinterpret_cast<char*>(&tmp), 2 * PagedFile::PAGE_SIZE, sizeof(int));
+    // page 0 is the least recently used one, so it has been evicted
+    file.read(reinterpret_cast<char*>(&tmp), 0, sizeof(int));
+    REQUIRE(file.getCacheMisses() == 4);
+    REQUIRE(file.getCacheHits() == 1);
+}
+
+TEST_CASE("PagedFile Concurrent Reads With Cache", "[PagedFile]") {
+    std::filesystem::remove("tmp_file");
+    const int N = 64 * PagedFile::PAGE_SIZE, THREADS = 4;
+    std::vector<char> data(N);
+    std::mt19937 gen{1919810};
+    for (auto& c : data) c = static_cast<char>(gen());
+    PagedFile file;
+    file.open("tmp_file");
+    file.write(data.data(), 0, N);
+    // the cache is much smaller than the file, so the threads keep evicting each other's pages
+    file.setCacheCapacity(8 * PagedFile::PAGE_SIZE);
+    std::atomic<int> bad_reads = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&file, &data, &bad_reads, t] {
+            std::mt19937 gen(t);
+            std::vector<char> result(1000);
+            for (int i = 0; i < 5000; i++) {
+                const int pos = gen() % (N - 1000);
+                file.read(result.data(), pos, 1000);
+                if (!std::equal(result.begin(), result.end(), data.begin() + pos)) ++bad_reads;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    REQUIRE(bad_reads == 0);
+    REQUIRE(file.getCacheHits() + file.getCacheMisses() > 0);
+}
+
+TEST_CASE("MemoryRiver With Page Cache", "[MemoryRiver]") {
+    std::filesystem::remove("tmp_file");
+    const int N = 10000;
+    std::vector<int> pos;
+    {
+        MemoryRiver<long long, 1> mr("tmp_file");
+        mr.initialise();
+        mr.setCacheCapacity(16 * PagedFile::PAGE_SIZE);
+        for (int i = 0; i < N; i++) {
+            pos.push_back(mr.write(1LL * i * i));
+        }
+        for (int i = 0; i < N; i += 2) {
+            mr.erase(pos[i]);
+        }
+        mr.writeInfo(N, 1);
+        for (int i = 1; i < N; i += 2) {
+            long long val;
+            mr.read(val, pos[i]);
+            REQUIRE(val == 1LL * i * i);
+        }
+        REQUIRE(mr.getCacheHits() > 0);
+    }
+    {
+        MemoryRiver<long long, 1> mr("tmp_file");
+        mr.initialise();
+        int tmp;
+        mr.getInfo(tmp, 1);
+        REQUIRE(tmp == N);
+        for (int i = 1; i < N; i += 2) {
+            long long val;
+            mr.read(val, pos[i]);
+            REQUIRE(val == 1LL * i * i);
+        }
+        // freed slots are reused after reopening
+        for (int i = 0; i < N / 2; i++) {
+            REQUIRE(mr.write(0) <= N);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "SnapshotMap.hpp"
+
+namespace {
+struct Item {
+    int key;
+    long long a, b;
+};
+}  // namespace
+
+TEST_CASE("EpochReclaimer Waits For Pinned Readers", "[SnapshotMap]") {
+    EpochReclaimer reclaimer;
+    int freed = 0;
+    reclaimer.retire([&freed] { freed++; });
+    reclaimer.advance();
+    REQUIRE(freed == 1);
+    {
+        const auto guard = reclaimer.pin();
+        reclaimer.retire([&freed] { freed++; });
+        reclaimer.advance();
+        reclaimer.advance();
+        REQUIRE(freed == 1);
+        REQUIRE(reclaimer.getPending() == 1);
+    }
+    // a reader pinned after the object was retired can't see it
+    const auto guard = reclaimer.pin();
+    reclaimer.advance();
+    REQUIRE(freed == 2);
+    reclaimer.retire([&freed] { freed++; });
+    reclaimer.advance();
+    REQUIRE(freed == 2);
+}
+
+TEST_CASE("SnapshotMap Random Operations", "[SnapshotMap]") {
+    SnapshotMap<Item, &Item::key> map;
+    std::map<int, long long> reference;
+    std::mt19937 gen{20261018};
+    for (int i = 0; i < 100000; i++) {
+        // erasing as often as inserting leaves many tombstones
+        const int key = gen() % (i < 50000 ? 5000 : 200);
+        if (gen() % 2) {
+            const long long value = gen();
+            map.put({key, value, value});
+            reference[key] = value;
+        } else {
+            map.erase(key);
+            reference.erase(key);
+        }
+        if (i % 100 == 0) {
+            REQUIRE(map.size() == reference.size());
+            const int probe = gen() % 5000;
+            const auto item = map.find(probe);
+            REQUIRE(item.has_value() == reference.contains(probe));
+            if (item) REQUIRE(item->a == reference[probe]);
+        }
+    }
+    for (const auto& [key, value] : reference) REQUIRE(map.find(key)->a == value);
+    // nothing is pinned, so every replaced version is freed at once
+    REQUIRE(map.getPending() == 0);
+}
+
+TEST_CASE("SnapshotMap Concurrent Readers", "[SnapshotMap]") {
+    SnapshotMap<Item, &Item::key> map;
+    const int N = 1000, READERS = 4;
+    for (int key = 0; key < N; key++) map.put({key, 0, 0});
+    std::atomic<bool> done = false;
+    std::atomic<int> bad_reads = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < READERS; t++) {
+        readers.emplace_back([&map, &done, &bad_reads, t] {
+            std::mt19937 gen(t);
+            while (!done) {
+                const auto item = map.find(gen() % N);
+                // every version is written whole, and the keys below N are never erased
+                if (!item || item->a != item->b) ++bad_reads;
+            }
+        });
+    }
+    // the writer keeps growing the map with other keys, so it is also rehashed under the readers
+    std::mt19937 gen{42};
+    for (int i = 0; i < 200000; i++) {
+        const long long value = gen();
+        map.put({static_cast<int>(gen() % N), value, value});
+        if (i % 4 == 0) map.put({N + i, value, value});
+        if (i % 8 == 0) map.erase(N + i - 4);
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+    REQUIRE(bad_reads == 0);
+    for (int key = 0; key < N; key++) {
+        const auto item = map.find(key);
+        REQUIRE(item);
+        REQUIRE(item->a == item->b);
+    }
+}
@@ -22,6 +22,7 @@ TEST_CASE("UsersManager Basic Usage", "[UsersManager]") {
 
     SECTION("Automatically creates root account") {
         REQUIRE(manager.useridExists(util::toArray<User::USERID_T>("root")));
+        REQUIRE(UsersManager::isUserDataFile("user_data"));
     }
 
     SECTION("Add new user") {
@@ -53,6 +54,20 @@ TEST_CASE("UsersManager Basic Usage", "[UsersManager]") {
         REQUIRE(!manager.useridExists(util::toArray<User::USERID_T>("myuserid")));
     }
 
+    SECTION("Modify Login Count") {
+        User user = gen_user("myuserid", "myusername", "123456", 1);
+        manager.addUser(user);
+        const auto userid = util::toArray<User::USERID_T>("myuserid");
+        manager.modifyLoginCount(userid, 1);
+        manager.modifyLoginCount(userid, 1);
+        REQUIRE(manager.getLoginCount(userid) == 2);
+        manager.modifyLoginCount(userid, -1);
+        REQUIRE(manager.getLoginCount(userid) == 1);
+        // the other fields are untouched
+        user.login_count = 1;
+        REQUIRE(manager.getUserByUserid(userid) == user);
+    }
+
     SECTION("Gets User") {
         User user = gen_user("myuserid", "1+1", "2", 1);
         manager.addUser(user);
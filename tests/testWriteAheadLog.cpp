@@ -0,0 +1,176 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "MemoryRiver.hpp"
+#include "PagedFile.hpp"
+#include "WriteAheadLog.hpp"
+
+namespace {
+struct Record {
+    int id;
+    long long value;
+};
+
+std::string readRaw(const std::string& file_name) {
+    std::ifstream in(file_name, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), {}};
+}
+}  // namespace
+
+TEST_CASE("WriteAheadLog Recovers Committed Transactions After A Crash", "[WriteAheadLog]") {
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+    auto& log = WriteAheadLog::getInstance();
+    const int N = 100;
+    const pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        // the child crashes in the middle of a transaction, without closing anything
+        log.open("tmp_wal");
+        MemoryRiver<Record, 1> mr("tmp_file");
+        mr.initialise();
+        for (int i = 1; i <= N; i++) {
+            WriteAheadLog::Transaction transaction;
+            mr.write(Record{i, i * 10LL});
+            mr.writeInfo(i, 1);
+        }
+        WriteAheadLog::Transaction transaction;
+        mr.update(Record{-1, -1}, 1);
+        mr.write(Record{-1, -1});
+        mr.writeInfo(-1, 1);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    REQUIRE(WIFEXITED(status));
+    // a batch torn by the crash is discarded
+    {
+        std::ofstream out("tmp_wal", std::ios::binary | std::ios::app);
+        out << "WAL1 torn";
+    }
+
+    REQUIRE(log.open("tmp_wal") > 0);
+    {
+        MemoryRiver<Record, 1> mr("tmp_file");
+        mr.initialise();
+        int info;
+        mr.getInfo(info, 1);
+        REQUIRE(info == N);
+        for (int i = 1; i <= N; i++) {
+            Record record;
+            mr.read(record, i);
+            REQUIRE(record.id == i);
+            REQUIRE(record.value == i * 10LL);
+        }
+        // the slot written by the uncommitted transaction is allocated again
+        REQUIRE(mr.write(Record{N + 1, 0}) == N + 1);
+    }
+    log.close();
+    REQUIRE(std::filesystem::file_size("tmp_wal") == 0);
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+}
+
+TEST_CASE("WriteAheadLog Keeps Writes In Memory Until Committed", "[WriteAheadLog]") {
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+    std::filesystem::remove("tmp_mapped_file");
+    auto& log = WriteAheadLog::getInstance();
+    log.open("tmp_wal");
+    {
+        PagedFile paged;
+        paged.open("tmp_file");
+        MappedFile mapped;
+        mapped.open("tmp_mapped_file");
+        const std::string data(3 * WriteAheadLog::PAGE_SIZE / 2, 'x');
+        {
+            WriteAheadLog::Transaction transaction;
+            paged.write(data.data(), 100, data.size());
+            mapped.write(data.data(), 100, data.size());
+            REQUIRE(paged.size() == 100 + static_cast<long long>(data.size()));
+            std::string result(data.size(), '\0');
+            paged.read(result.data(), 100, result.size());
+            REQUIRE(result == data);
+            mapped.read(result.data(), 100, result.size());
+            REQUIRE(result == data);
+            // the batch can't be committed while the transaction is running
+            REQUIRE(readRaw("tmp_file").find('x') == std::string::npos);
+            REQUIRE(readRaw("tmp_mapped_file").find('x') == std::string::npos);
+        }
+        log.flush();
+        REQUIRE(readRaw("tmp_file").substr(100) == data);
+        // a write outside any transaction is committed as well
+        paged.write("y", 0, 1);
+        log.flush();
+        REQUIRE(readRaw("tmp_file")[0] == 'y');
+    }
+    log.close();
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+    std::filesystem::remove("tmp_mapped_file");
+}
+
+TEST_CASE("WriteAheadLog Commits Concurrent Transactions In Groups", "[WriteAheadLog]") {
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+    auto& log = WriteAheadLog::getInstance();
+    log.open("tmp_wal");
+    const int THREADS = 8, N = 50;
+    {
+        MemoryRiver<Record, 1> mr("tmp_file");
+        mr.initialise();
+        const size_t commits_before = log.getCommitCount();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++) {
+            threads.emplace_back([&mr, t] {
+                for (int i = 0; i < N; i++) {
+                    WriteAheadLog::Transaction transaction;
+                    const int index = mr.write(Record{t, i});
+                    mr.update(static_cast<long long>(index), index, offsetof(Record, value));
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        REQUIRE(log.getCommitCount() - commits_before <= THREADS * N);
+        for (int i = 1; i <= THREADS * N; i++) {
+            Record record;
+            mr.read(record, i);
+            REQUIRE(record.value == i);
+        }
+    }
+    log.close();
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+}
+
+TEST_CASE("WriteAheadLog Doesn't Wait For Asynchronous Transactions", "[WriteAheadLog]") {
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+    auto& log = WriteAheadLog::getInstance();
+    log.open("tmp_wal", WriteAheadLog::Durability::ASYNC);
+    {
+        PagedFile paged;
+        paged.open("tmp_file");
+        const size_t commits_before = log.getCommitCount();
+        {
+            WriteAheadLog::Transaction transaction;
+            paged.write("x", 0, 1);
+        }
+        // the batch is committed in the background, or at the latest by flush
+        log.flush();
+        REQUIRE(log.getCommitCount() == commits_before + 1);
+        REQUIRE(readRaw("tmp_file") == "x");
+    }
+    log.close();
+    std::filesystem::remove("tmp_wal");
+    std::filesystem::remove("tmp_file");
+}
@@ -0,0 +1,208 @@
+// Converts the index files written by older versions, where every index was a BlockList.
+//
+// Usage: migrate_index [data_directory]
+// Run it once with the bookstore stopped. The book indexes are read in order and bulk-loaded into
+// new trees, which then replace the old files; the keyword index becomes an inverted index. The
+// ISBN hash index is built from the ISBN index, and the n-gram, price and quantity indexes from the
+// books it lists. The users are moved into a record file with a hash index on userid. An operation
+// log of fixed-size entries is rewritten in the variable-length format, keeping the command texts.
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "BPlusTree.hpp"
+#include "BlockList.hpp"
+#include "BooksManager.hpp"
+#include "HashIndex.hpp"
+#include "InvertedIndex.hpp"
+#include "MappedFile.hpp"
+#include "MemoryRiver.hpp"
+#include "OperationLog.hpp"
+#include "UsersManager.hpp"
+
+namespace {
+// Returns all pairs in the BlockList file_name.
+template <class Key, class T>
+std::vector<std::pair<Key, T>> readBlockList(const std::string& file_name) {
+    BlockList<Key, T, MappedFile> old_index;
+    old_index.initialise(file_name);
+    return old_index.queryAllKeyValuePairs();
+}
+// Writes pairs into a new HashIndex file_name.
+template <class Key, class T>
+void writeHashIndex(const std::string& file_name, const std::vector<std::pair<Key, T>>& pairs) {
+    std::filesystem::remove(file_name);
+    HashIndex<Key, T, MappedFile> new_index;
+    new_index.initialise(file_name);
+    for (const auto& [key, value] : pairs) new_index.insert(key, value);
+}
+
+// Writes sorted pairs into a new BPlusTree file_name.
+template <class Key>
+void writeBPlusTree(const std::string& file_name, std::vector<std::pair<Key, int>> pairs) {
+    std::ranges::sort(pairs);
+    std::filesystem::remove(file_name);
+    BPlusTree<Key, int, MappedFile> new_index;
+    new_index.initialise(file_name);
+    new_index.bulkLoad(pairs);
+    std::printf("%s: %zu entries built\n", file_name.c_str(), pairs.size());
+}
+// Builds the indexes that older versions didn't have from the records of the books with ids.
+void buildBookIndexes(const std::vector<std::pair<Book::ISBN_T, int>>& ids) {
+    MemoryRiver<Book, 0, MappedFile> main_data;
+    main_data.initialise("book_data");
+    std::vector<std::pair<BooksManager::NGRAM_T, int>> ngrams;
+    std::vector<std::pair<long long, int>> prices;
+    std::vector<std::pair<int, int>> quantities;
+    for (const auto& [ISBN, id] : ids) {
+        Book book;
+        main_data.read(book, id);
+        for (const auto& ngram :
+             BooksManager::getNgrams(BooksManager::NAME_NGRAM, book.book_name.data())) {
+            ngrams.emplace_back(ngram, id);
+        }
+        for (const auto& ngram :
+             BooksManager::getNgrams(BooksManager::AUTHOR_NGRAM, book.author.data())) {
+            ngrams.emplace_back(ngram, id);
+        }
+        prices.emplace_back(book.price, id);
+        quantities.emplace_back(book.quantity, id);
+    }
+    const std::string ngram_file = "book_ngram_index";
+    std::filesystem::remove(ngram_file);
+    std::filesystem::remove(ngram_file + "_postings");
+    std::ranges::sort(ngrams);
+    InvertedIndex<BooksManager::NGRAM_T, MappedFile> ngram_index;
+    ngram_index.initialise(ngram_file);
+    ngram_index.bulkLoad(ngrams);
+    std::printf("%s: %zu entries built\n", ngram_file.c_str(), ngrams.size());
+    writeBPlusTree("book_price_index", std::move(prices));
+    writeBPlusTree("book_quantity_index", std::move(quantities));
+}
+
+template <class Key>
+void migrate(const std::string& file_name) {
+    if (!std::filesystem::exists(file_name)) {
+        std::printf("%s: not found, skipped\n", file_name.c_str());
+        return;
+    }
+    if (BPlusTree<Key, int, MappedFile>::isTreeFile(file_name)) {
+        std::printf("%s: not in the old format, skipped\n", file_name.c_str());
+        return;
+    }
+    const auto pairs = readBlockList<Key, int>(file_name);
+    const std::string tmp_name = file_name + ".migrating";
+    std::filesystem::remove(tmp_name);
+    {
+        BPlusTree<Key, int, MappedFile> new_index;
+        new_index.initialise(tmp_name);
+        new_index.bulkLoad(pairs);
+    }
+    std::filesystem::rename(tmp_name, file_name);
+    std::printf("%s: %zu entries migrated\n", file_name.c_str(), pairs.size());
+    if constexpr (std::is_same_v<Key, Book::ISBN_T>) {
+        writeHashIndex("book_ISBN_hash", pairs);
+        std::printf("book_ISBN_hash: %zu entries built\n", pairs.size());
+        buildBookIndexes(pairs);
+    }
+}
+void migrateKeywords() {
+    const std::string file_name = "book_keyword_index", postings_name = file_name + "_postings";
+    if (!std::filesystem::exists(file_name) || std::filesystem::exists(postings_name)) {
+        std::printf("%s: not in the old format, skipped\n", file_name.c_str());
+        return;
+    }
+    const auto pairs = readBlockList<Book::KEYWORD_T, int>(file_name);
+    const std::string tmp_name = file_name + ".migrating";
+    std::filesystem::remove(tmp_name);
+    std::filesystem::remove(tmp_name + "_postings");
+    {
+        InvertedIndex<Book::KEYWORD_T, MappedFile> new_index;
+        new_index.initialise(tmp_name);
+        new_index.bulkLoad(pairs);
+    }
+    std::filesystem::rename(tmp_name + "_postings", postings_name);
+    std::filesystem::rename(tmp_name, file_name);
+    std::printf("%s: %zu entries migrated\n", file_name.c_str(), pairs.size());
+}
+void migrateUsers() {
+    const std::string file_name = "user_data";
+    if (!std::filesystem::exists(file_name)) {
+        std::printf("%s: not found, skipped\n", file_name.c_str());
+        return;
+    }
+    if (UsersManager::isUserDataFile(file_name)) {
+        std::printf("%s: not in the old format, skipped\n", file_name.c_str());
+        return;
+    }
+    const auto pairs = readBlockList<User::USERID_T, User>(file_name);
+    const std::string tmp_name = file_name + ".migrating";
+    std::filesystem::remove(tmp_name);
+    std::vector<std::pair<User::USERID_T, int>> ids;
+    {
+        UsersManager::UserData user_data(tmp_name);
+        user_data.initialise();
+        for (const auto& [userid, user] : pairs) ids.emplace_back(userid, user_data.write(user));
+        user_data.writeInfo(UsersManager::USER_DATA_MAGIC, 1);
+    }
+    writeHashIndex("user_userid_index", ids);
+    std::filesystem::rename(tmp_name, file_name);
+    std::printf("%s: %zu entries migrated\n", file_name.c_str(), pairs.size());
+}
+// The entry of the operation log before it had a variable-length format.
+struct FixedOperationLogEntry {
+    long long timestamp;
+    User::USERID_T userid;
+    int user_privilege;
+    std::array<char, 300> op;
+    int is_success;
+};
+void migrateOperationLog() {
+    const std::string file_name = "log_operation", index_file_name = "log_operation_index";
+    if (!std::filesystem::exists(file_name) || std::filesystem::exists(index_file_name)) {
+        std::printf("%s: not in the old format, skipped\n", file_name.c_str());
+        return;
+    }
+    const std::string tmp_name = file_name + ".migrating";
+    std::filesystem::remove(tmp_name);
+    int count = 0;
+    {
+        MemoryRiver<FixedOperationLogEntry, 1> old_log;
+        old_log.initialise(file_name);
+        old_log.getInfo(count, 1);
+        OperationLogFile new_log;
+        new_log.open(tmp_name, index_file_name);
+        for (int id = 1; id <= count; id++) {
+            FixedOperationLogEntry old_entry;
+            old_log.read(old_entry, id);
+            OperationLogEntry entry{old_entry.timestamp, old_entry.userid,
+                                    old_entry.user_privilege, Log::Operation(Log::OpCode::LEGACY),
+                                    old_entry.is_success};
+            // the texts of TEXT arguments are concatenated, each holding at most 255 bytes
+            const std::string text(old_entry.op.data());
+            for (size_t pos = 0; pos < text.size(); pos += 255) {
+                entry.op.add(Log::Field::TEXT, text.substr(pos, 255));
+            }
+            new_log.append(&entry, 1);
+        }
+    }
+    std::filesystem::rename(tmp_name, file_name);
+    std::printf("%s: %d entries migrated\n", file_name.c_str(), count);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) std::filesystem::current_path(argv[1]);
+    migrate<Book::ISBN_T>("book_ISBN_index");
+    migrate<Book::BOOKNAME_T>("book_name_index");
+    migrate<Book::AUTHOR_T>("book_author_index");
+    migrateKeywords();
+    migrateUsers();
+    migrateOperationLog();
+    return 0;
+}